@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file    core_cm3.h (host build)
+  * @brief   Stands in for cmsis_compiler.h, then pulls in the real CMSIS
+  *          core_cm3.h with its system blocks (DWT, CoreDebug, SCB, NVIC,
+  *          SysTick) moved from 0xE000xxxx into host memory.
+  ******************************************************************************
+  */
+
+#ifndef __HOST_CORE_CM3_H
+#define __HOST_CORE_CM3_H
+
+#include <stdint.h>
+
+/* Claim cmsis_compiler.h's guard so core_cm3.h takes the definitions below */
+#define __CMSIS_COMPILER_H
+
+#define __ASM                   __asm__
+#define __INLINE                inline
+#define __STATIC_INLINE         static inline
+#define __STATIC_FORCEINLINE    __attribute__((always_inline)) static inline
+#define __NO_RETURN             __attribute__((__noreturn__))
+#define __USED                  __attribute__((used))
+#define __WEAK                  __attribute__((weak))
+#define __PACKED                __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT         struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION          union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)            __attribute__((aligned(x)))
+#define __RESTRICT              __restrict
+#define __COMPILER_BARRIER()    __asm__ volatile("" ::: "memory")
+
+/* Single-threaded host: barriers order the compiler only and the exclusive
+   monitor always succeeds */
+static inline void __DSB(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __ISB(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __DMB(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __NOP(void) { }
+static inline void __WFI(void) { }
+static inline void __enable_irq(void) { }
+static inline void __disable_irq(void) { }
+static inline uint32_t __get_PRIMASK(void) { return 0U; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+
+/* BASEPRI holds back the simulated interrupts, see host/sim.c */
+uint32_t __get_BASEPRI(void);
+void __set_BASEPRI(uint32_t basePri);
+
+static inline uint32_t __LDREXW(volatile uint32_t *addr)
+{
+  return __atomic_load_n(addr, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr)
+{
+  __atomic_store_n(addr, value, __ATOMIC_RELAXED);
+  return 0U;
+}
+
+static inline void __CLREX(void) { }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wint-to-pointer-cast"
+#include_next "core_cm3.h"
+#pragma GCC diagnostic pop
+
+/* Private peripheral bus image, see host/sim.c */
+extern uint8_t sim_ppb[];
+
+#undef SCS_BASE
+#undef ITM_BASE
+#undef DWT_BASE
+#undef CoreDebug_BASE
+#define SCS_BASE                ((uintptr_t)sim_ppb + 0xE000UL)
+#define ITM_BASE                ((uintptr_t)sim_ppb + 0x0000UL)
+#define DWT_BASE                ((uintptr_t)sim_ppb + 0x1000UL)
+#define CoreDebug_BASE          ((uintptr_t)sim_ppb + 0xEDF0UL)
+
+#endif /* __HOST_CORE_CM3_H */
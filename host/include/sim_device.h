@@ -0,0 +1,26 @@
+/**
+  ******************************************************************************
+  * @file    sim_device.h
+  * @brief   Host build: the real device header with every peripheral moved
+  *          from PERIPH_BASE into host memory, so firmware register accesses
+  *          hit the register models in host/sim.c. Force-included ahead of
+  *          every translation unit (-include), so the relocation is in place
+  *          before any source pulls in stm32f1xx.h itself.
+  ******************************************************************************
+  */
+
+#ifndef __SIM_DEVICE_H
+#define __SIM_DEVICE_H
+
+#include <stdint.h>
+#include <stm32f1xx.h>
+
+/* APB1, APB2 and AHB peripherals up to and including CRC */
+#define SIM_PERIPH_SIZE         0x24000UL
+
+extern uint8_t sim_periph[];
+
+#undef PERIPH_BASE
+#define PERIPH_BASE             ((uintptr_t)sim_periph)
+
+#endif /* __SIM_DEVICE_H */
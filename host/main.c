@@ -0,0 +1,278 @@
+/**
+  ******************************************************************************
+  * @file    main.c (host build)
+  * @brief   Runs the programmer core on Linux. STK500v2 frames are read from
+  *          stdin and answered on stdout, or served on a pseudo-terminal;
+  *          an ATtiny model sits on the HVSP pins.
+  *
+  *          Usage: programmer [-d attiny13|24|44|84|25|45|85] [-n]
+  *                                [-w file.vcd] [-s] [-p] [-l link]
+  *                                [-f faults] [-o] [-a baudrate]
+  *          -n leaves the pins unconnected, -w records the HVSP pins, -s
+  *          prints the wire analysis without a recording. -p serves the
+  *          link on a pseudo-terminal until SIGINT/SIGTERM, -l also
+  *          symlinks it, e.g. for avrdude -c stk500hvsp -P link. -f injects
+  *          target faults, see tiny_parse_faults(). -o starts with a link
+  *          open event, as the DTR edge of a host opening the port. -a
+  *          only checks autobaud against a sync byte sent at that rate and
+  *          exits with status 3 when it measures another one. The exit
+  *          status is 2 when the target saw timing violations.
+  ******************************************************************************
+  */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "boot.h"
+#include "delay.h"
+#include "irq.h"
+#include "linktest.h"
+#include "loop.h"
+#include "prog.h"
+#include "proto.h"
+#include "pty.h"
+#include "ring.h"
+#include "sim.h"
+#include "timer.h"
+#include "tiny.h"
+#include "trace.h"
+#include "uart.h"
+#include "usart.h"
+#include "vcd.h"
+
+#define SIM_HCLK_HZ       72000000U
+
+static tiny_t target;
+static vcd_t wave;
+static int host_out = STDOUT_FILENO;
+
+/* Link input, filled from stdin or the pseudo-terminal between loop passes */
+static uint8_t host_rx_buf[512];
+static ring_t host_rx = RING_INIT(host_rx_buf);
+
+/* Link events; a pipe or pseudo-terminal has no DTR, -o posts one open */
+static uint32_t host_link_buf[4];
+static ring_msg_t host_link = RING_INIT(host_link_buf);
+
+static void host_write(const uint8_t *buf, uint16_t len)
+{
+  while (len != 0U)
+  {
+    ssize_t n = write(host_out, buf, len);
+
+    if (n <= 0)
+    {
+      return;
+    }
+    buf += n;
+    len -= (uint16_t)n;
+  }
+}
+
+/* The usart.h interface over host_rx and host_write(), for loop.c */
+int usart_getc(void)
+{
+  return ring_get(&host_rx);
+}
+
+int usart_rx_pending(void)
+{
+  return ring_count(&host_rx) != 0U;
+}
+
+/* host_rx refuses bytes when full instead of overwriting them */
+uint32_t usart_rx_laps(void)
+{
+  return 0U;
+}
+
+void usart_commit(void)
+{
+}
+
+int usart_autobaud_poll(void)
+{
+  return 0;
+}
+
+int usart_link_event(uint32_t *event)
+{
+  return ring_msg_get(&host_link, event);
+}
+
+int usart_link_pending(void)
+{
+  return host_link.head != host_link.tail;
+}
+
+/**
+  * @brief  CMD_SET_BAUD: a pipe or a pseudo-terminal has no line rate, so
+  *         any valid request is accepted and ignored.
+  */
+uint8_t usart_cmd_set_baud(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)req;
+  (void)data;
+
+  *data_len = 0U;
+  return (len >= 5U) ? STATUS_CMD_OK : STATUS_CMD_FAILED;
+}
+
+static volatile sig_atomic_t host_stopping;
+
+static void host_stop(int sig)
+{
+  (void)sig;
+  host_stopping = 1;
+}
+
+int main(int argc, char **argv)
+{
+  const tiny_device_t *dev = tiny_find("attiny85");
+  const char *vcd_path = 0;
+  const char *link = 0;
+  tiny_faults_t faults = { 0 };
+  struct sigaction sa = { .sa_handler = host_stop };
+  int connected = 1;
+  int analyse = 0;
+  int pty = 0;
+  int in = STDIN_FILENO;
+  uint32_t autobaud = 0U;
+  uint8_t buf[sizeof(host_rx_buf)];
+  ssize_t n;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:nw:spl:f:oa:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'd':
+        dev = tiny_find(optarg);
+        if (dev == 0)
+        {
+          fprintf(stderr, "unknown device %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'n':
+        connected = 0;
+        break;
+      case 'w':
+        vcd_path = optarg;
+        analyse = 1;
+        break;
+      case 's':
+        analyse = 1;
+        break;
+      case 'l':
+        link = optarg;
+        pty = 1;
+        break;
+      case 'p':
+        pty = 1;
+        break;
+      case 'f':
+        if (tiny_parse_faults(&faults, optarg) != 0)
+        {
+          fprintf(stderr, "bad fault profile %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'o':
+        (void)ring_msg_put(&host_link, USART_LINK_OPEN);
+        break;
+      case 'a':
+        autobaud = (uint32_t)strtoul(optarg, 0, 0);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-d device] [-n] [-w file.vcd] [-s] [-p] [-l link] [-f faults] [-o] [-a baudrate]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  if (pty)
+  {
+    in = pty_open(link);
+    if (in < 0)
+    {
+      perror("pty");
+      return 1;
+    }
+    host_out = in;
+  }
+  sigaction(SIGINT, &sa, 0);
+  sigaction(SIGTERM, &sa, 0);
+
+  sim_init(SIM_HCLK_HZ);
+  if (connected)
+  {
+    tiny_init(&target, dev);
+    tiny_set_faults(&target, &faults);
+    tiny_attach(&target);
+  }
+  if (analyse)
+  {
+    if (vcd_open(&wave, vcd_path) != 0)
+    {
+      perror(vcd_path);
+      return 1;
+    }
+    vcd_attach(&wave);
+  }
+  boot_start();
+  boot_mark(BOOT_PHASE_CLOCK_LOCK);
+
+  irq_init();
+  delay_init();
+  if (autobaud != 0U)
+  {
+    return (uart_autobaud_check(autobaud) == 0) ? 0 : 3;
+  }
+  timer_init();
+  arena_init();
+  trace_init();
+  prog_init();
+  proto_init(host_write);
+  linktest_init(host_write);
+  loop_init();
+  boot_mark(BOOT_PHASE_LINK_UP);
+
+  while (!host_stopping)
+  {
+    /* Run until every task waits for input, as the firmware would sleep */
+    while (loop_poll() && !host_stopping)
+    {
+    }
+    n = pty ? pty_read(in, buf, sizeof(buf)) : read(in, buf, sizeof(buf));
+    if (n < 0 || (n == 0 && !pty))
+    {
+      break;
+    }
+    for (ssize_t i = 0; i < n; i++)
+    {
+      ring_put(&host_rx, buf[i]);
+    }
+    /* What the receive interrupts do */
+    irq_defer();
+  }
+
+  if (pty)
+  {
+    pty_close(in, link);
+  }
+  if (analyse)
+  {
+    vcd_close(&wave);
+    vcd_report(&wave, stderr);
+  }
+  if (connected)
+  {
+    tiny_report(&target, stderr);
+    return (tiny_violation_total(&target) != 0U) ? 2 : 0;
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+/**
+  ******************************************************************************
+  * @file    pty.c
+  * @brief   Host build: serves the host link on a pseudo-terminal.
+  ******************************************************************************
+  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "pty.h"
+
+/* The slave side is kept open by us as well: clients can come and go
+   without the master seeing a hang-up, and the raw mode set here stays. */
+static int pty_slave = -1;
+
+/**
+  * @brief  Creates the pseudo-terminal and prints its name on stderr.
+  * @param  link: path of a symlink to the slave, or NULL
+  * @retval master file descriptor, -1 on error
+  */
+int pty_open(const char *link)
+{
+  struct termios tio;
+  const char *name;
+  int fd;
+
+  fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0 || (name = ptsname(fd)) == 0)
+  {
+    return -1;
+  }
+
+  pty_slave = open(name, O_RDWR | O_NOCTTY);
+  if (pty_slave < 0 || tcgetattr(pty_slave, &tio) != 0)
+  {
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(pty_slave, TCSANOW, &tio);
+
+  if (link != 0)
+  {
+    unlink(link);
+    if (symlink(name, link) != 0)
+    {
+      return -1;
+    }
+  }
+  fprintf(stderr, "host link on %s\n", (link != 0) ? link : name);
+  return fd;
+}
+
+/**
+  * @brief  Reads from the master, waiting up to 100 ms for a client.
+  * @retval bytes read, 0 when nothing arrived, -1 when interrupted
+  */
+ssize_t pty_read(int fd, void *buf, size_t len)
+{
+  struct pollfd p = { .fd = fd, .events = POLLIN };
+  ssize_t n;
+
+  switch (poll(&p, 1, 100))
+  {
+    case -1:
+      return -1;
+    case 0:
+      return 0;
+    default:
+      break;
+  }
+
+  n = read(fd, buf, len);
+  if (n < 0 && errno != EINTR)
+  {
+    /* No client on the slave side yet */
+    usleep(10000);
+    return 0;
+  }
+  return n;
+}
+
+void pty_close(int fd, const char *link)
+{
+  if (link != 0)
+  {
+    unlink(link);
+  }
+  if (pty_slave >= 0)
+  {
+    close(pty_slave);
+  }
+  close(fd);
+}
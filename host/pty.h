@@ -0,0 +1,20 @@
+/**
+  ******************************************************************************
+  * @file    pty.h
+  * @brief   Host build: serves the host link on a pseudo-terminal, so
+  *          avrdude (-c stk500hvsp) or tools/stk500v2.py can drive the
+  *          simulated programmer like the real one.
+  ******************************************************************************
+  */
+
+#ifndef __PTY_H
+#define __PTY_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+int pty_open(const char *link);
+ssize_t pty_read(int fd, void *buf, size_t len);
+void pty_close(int fd, const char *link);
+
+#endif /* __PTY_H */
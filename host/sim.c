@@ -0,0 +1,304 @@
+/**
+  ******************************************************************************
+  * @file    sim.c
+  * @brief   Host build: simulated time and peripheral register models.
+  ******************************************************************************
+  */
+
+#include "sim.h"
+#include "delay.h"
+#include "gpio.h"
+#include "irq.h"
+#include "timer.h"
+
+/* Register images. Peripherals without behaviour below (TIM, DMA, CRC, USB,
+   RCC, ...) are plain memory: writes stick and reads return them. */
+uint8_t sim_periph[SIM_PERIPH_SIZE] __attribute__((aligned(1024)));
+uint8_t sim_ppb[0x10000] __attribute__((aligned(1024)));
+
+static uint64_t sim_ps;
+static uint64_t sim_ps_per_cycle_x1000;   /* ps per core cycle, x1000 */
+static uint64_t sim_cycles;
+static sim_pin_model_t *sim_models;
+static int sim_in_timer_irq;
+static int sim_timer_pending;
+static int sim_in_pendsv;
+static int sim_pendsv_pending;
+static uint32_t sim_basepri;
+static int sim_timer_masked;      /* fell due while BASEPRI held it back */
+static int sim_pendsv_masked;
+
+/* Next one-shot deadline, kept by src/timer.c */
+extern uint64_t timer_next_us;
+
+static void sim_gpio_sample(GPIO_TypeDef *port, uint32_t levels)
+{
+  for (sim_pin_model_t *m = sim_models; m != 0; m = m->next)
+  {
+    if (m->port == port && m->sample != 0)
+    {
+      m->sample(m->ctx, sim_ps, levels);
+    }
+  }
+}
+
+/**
+  * @brief  Clears every register image and sets the core clock.
+  * @param  hclk: core clock in Hz
+  * @retval None
+  */
+void sim_init(uint32_t hclk)
+{
+  for (uint32_t i = 0U; i < SIM_PERIPH_SIZE; i++)
+  {
+    sim_periph[i] = 0U;
+  }
+  for (uint32_t i = 0U; i < sizeof(sim_ppb); i++)
+  {
+    sim_ppb[i] = 0U;
+  }
+
+  /* Reset values the firmware relies on */
+  RCC->CR = RCC_CR_HSION | RCC_CR_HSIRDY;
+  GPIOA->CRL = 0x44444444U;
+  GPIOA->CRH = 0x44444444U;
+  USART1->SR = USART_SR_TXE | USART_SR_TC;
+
+  SystemCoreClock = hclk;
+  sim_ps = 0U;
+  sim_cycles = 0U;
+  sim_ps_per_cycle_x1000 = 1000000000000000ULL / hclk;
+  sim_models = 0;
+  sim_in_timer_irq = 0;
+  sim_timer_pending = 0;
+  sim_in_pendsv = 0;
+  sim_pendsv_pending = 0;
+  sim_basepri = 0U;
+  sim_timer_masked = 0;
+  sim_pendsv_masked = 0;
+}
+
+/**
+  * @brief  Tells whether BASEPRI holds back an interrupt at this level.
+  */
+static int sim_masked(uint32_t prio)
+{
+  return sim_basepri != 0U && (prio << (8U - __NVIC_PRIO_BITS)) >= sim_basepri;
+}
+
+void sim_attach(sim_pin_model_t *model)
+{
+  model->next = sim_models;
+  sim_models = model;
+}
+
+uint64_t sim_now_ps(void)
+{
+  return sim_ps;
+}
+
+/**
+  * @brief  Runs the TIM2 interrupt, again while callbacks kick it. It does
+  *         not nest: a kick from inside only marks it pending.
+  */
+static void sim_timer_irq(void)
+{
+  if (sim_masked(IRQ_PRIO_TIMER))
+  {
+    sim_timer_masked = 1;
+    return;
+  }
+  if (sim_in_timer_irq)
+  {
+    sim_timer_pending = 1;
+    return;
+  }
+  sim_in_timer_irq = 1;
+  do
+  {
+    sim_timer_pending = 0;
+    TIM2_IRQHandler();
+  } while (sim_timer_pending);
+  sim_in_timer_irq = 0;
+}
+
+/**
+  * @brief  Moves simulated time forward and mirrors it into DWT->CYCCNT.
+  *         A one-shot that falls due interrupts here.
+  */
+void sim_advance_cycles(uint64_t cycles)
+{
+  sim_cycles += cycles;
+  sim_ps = sim_cycles * sim_ps_per_cycle_x1000 / 1000U;
+  if ((CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) != 0U && (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) != 0U)
+  {
+    DWT->CYCCNT += (uint32_t)cycles;
+  }
+  if (timer_now_us() >= timer_next_us)
+  {
+    sim_timer_irq();
+  }
+}
+
+/**
+  * @brief  timer_now_us() for the host: simulated time.
+  */
+uint64_t timer_now_us(void)
+{
+  return sim_ps / 1000000U;
+}
+
+/**
+  * @brief  timer_hw_kick() for the host: the pended TIM2 interrupt runs at
+  *         once.
+  */
+void timer_hw_kick(void)
+{
+  sim_timer_irq();
+}
+
+void sim_advance_ps(uint64_t ps)
+{
+  sim_advance_cycles((ps * 1000U + sim_ps_per_cycle_x1000 - 1U) / sim_ps_per_cycle_x1000);
+}
+
+/**
+  * @brief  Output pins of a port, from the MODE fields of CRL/CRH.
+  */
+uint32_t sim_gpio_outputs(GPIO_TypeDef *port)
+{
+  uint32_t outputs = 0U;
+
+  for (uint32_t pin = 0U; pin < 16U; pin++)
+  {
+    uint32_t cr = (pin < 8U) ? port->CRL : port->CRH;
+
+    if (((cr >> ((pin & 7U) * 4U)) & 0x3U) != 0U)
+    {
+      outputs |= 1UL << pin;
+    }
+  }
+  return outputs;
+}
+
+/**
+  * @brief  Pin levels as IDR shows them: output pins read back ODR,
+  *         model-driven inputs take the model level, other inputs follow
+  *         their pull-up/down.
+  */
+static uint32_t sim_gpio_levels(GPIO_TypeDef *port)
+{
+  uint32_t outputs = sim_gpio_outputs(port);
+  uint32_t idr = port->ODR;   /* outputs, and the pull direction of inputs */
+
+  for (sim_pin_model_t *m = sim_models; m != 0; m = m->next)
+  {
+    if (m->port == port && m->input != 0)
+    {
+      uint32_t driven = 0U;
+      uint32_t levels = m->input(m->ctx, sim_ps, &driven);
+
+      driven &= ~outputs;
+      idr = (idr & ~driven) | (levels & driven);
+    }
+  }
+  return idr & 0xFFFFU;
+}
+
+/**
+  * @brief  Applies BSRR/BRR to ODR and shows the new levels to the models.
+  */
+void host_gpio_write(GPIO_TypeDef *port)
+{
+  uint32_t bsrr = port->BSRR;
+  uint32_t outputs;
+
+  port->ODR = (port->ODR & ~((bsrr >> 16) | port->BRR)) | (bsrr & 0xFFFFU);
+  port->BSRR = 0U;
+  port->BRR = 0U;
+
+  sim_advance_cycles(SIM_GPIO_WRITE_CYCLES);
+
+  outputs = sim_gpio_outputs(port);
+  for (sim_pin_model_t *m = sim_models; m != 0; m = m->next)
+  {
+    if (m->port == port && m->output != 0)
+    {
+      m->output(m->ctx, sim_ps, port->ODR & outputs, outputs);
+    }
+  }
+  sim_gpio_sample(port, sim_gpio_levels(port));
+}
+
+/**
+  * @brief  Rebuilds IDR.
+  */
+void host_gpio_read(GPIO_TypeDef *port)
+{
+  sim_advance_cycles(SIM_GPIO_READ_CYCLES);
+
+  port->IDR = sim_gpio_levels(port);
+  sim_gpio_sample(port, port->IDR);
+}
+
+/**
+  * @brief  irq_defer() for the host: PendSV runs at once, again when it is
+  *         pended from inside.
+  */
+void irq_defer(void)
+{
+  if (sim_masked(IRQ_PRIO_DEFERRED))
+  {
+    sim_pendsv_masked = 1;
+    return;
+  }
+  if (sim_in_pendsv)
+  {
+    sim_pendsv_pending = 1;
+    return;
+  }
+  sim_in_pendsv = 1;
+  do
+  {
+    sim_pendsv_pending = 0;
+    PendSV_Handler();
+  } while (sim_pendsv_pending);
+  sim_in_pendsv = 0;
+}
+
+/**
+  * @brief  delay_until() for the host: jumps to the deadline.
+  */
+void delay_until(uint32_t deadline)
+{
+  int32_t remaining = (int32_t)(deadline - DWT->CYCCNT);
+
+  if (remaining > 0)
+  {
+    sim_advance_cycles((uint64_t)remaining);
+  }
+}
+
+uint32_t __get_BASEPRI(void)
+{
+  return sim_basepri;
+}
+
+/**
+  * @brief  __set_BASEPRI() for the host: interrupts that fell due while
+  *         masked run once the new level lets them through.
+  */
+void __set_BASEPRI(uint32_t basePri)
+{
+  sim_basepri = basePri;
+  if (sim_timer_masked && !sim_masked(IRQ_PRIO_TIMER))
+  {
+    sim_timer_masked = 0;
+    sim_timer_irq();
+  }
+  if (sim_pendsv_masked && !sim_masked(IRQ_PRIO_DEFERRED))
+  {
+    sim_pendsv_masked = 0;
+    irq_defer();
+  }
+}
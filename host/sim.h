@@ -0,0 +1,49 @@
+/**
+  ******************************************************************************
+  * @file    sim.h
+  * @brief   Host build: simulated time and peripheral register models.
+  *
+  *          Simulated time only moves when the firmware touches a modelled
+  *          peripheral or waits (delay_until()), and DWT->CYCCNT always
+  *          shows it in core cycles. Runs are therefore deterministic and
+  *          their timings describe the wire, not the host CPU.
+  ******************************************************************************
+  */
+
+#ifndef __SIM_H
+#define __SIM_H
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+/* Core cycles charged per GPIO register access (APB2 at HCLK) */
+#define SIM_GPIO_WRITE_CYCLES   2U
+#define SIM_GPIO_READ_CYCLES    3U
+/* Cortex-M3 exception entry, from the edge to the handler's first instruction */
+#define SIM_IRQ_ENTRY_CYCLES    12U
+
+/**
+  * @brief Something wired to GPIO pins. output() sees the port every time
+  *        the firmware writes it, input() returns the levels of the pins the
+  *        model drives and sets *driven to their mask. sample() is for
+  *        observers: it sees the whole port, inputs included, after every
+  *        access.
+  */
+typedef struct sim_pin_model
+{
+  GPIO_TypeDef *port;
+  void (*output)(void *ctx, uint64_t t_ps, uint32_t levels, uint32_t outputs);
+  uint32_t (*input)(void *ctx, uint64_t t_ps, uint32_t *driven);
+  void (*sample)(void *ctx, uint64_t t_ps, uint32_t levels);
+  void *ctx;
+  struct sim_pin_model *next;
+} sim_pin_model_t;
+
+void sim_init(uint32_t hclk);
+void sim_attach(sim_pin_model_t *model);
+uint64_t sim_now_ps(void);
+void sim_advance_cycles(uint64_t cycles);
+void sim_advance_ps(uint64_t ps);
+uint32_t sim_gpio_outputs(GPIO_TypeDef *port);
+
+#endif /* __SIM_H */
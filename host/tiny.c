@@ -0,0 +1,584 @@
+/**
+  ******************************************************************************
+  * @file    tiny.c
+  * @brief   Host build: behavioural ATtiny HVSP target.
+  ******************************************************************************
+  */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tiny.h"
+#include "board.h"
+#include "sim.h"
+
+/* First violations printed with their time stamp */
+#define TINY_LOG_MAX        16U
+
+static const tiny_device_t tiny_devices[] =
+{
+  /* name       signature             flash  page  ee   eep  fuses                  n  flash eeprom erase  fuse */
+  { "attiny13", { 0x1E, 0x90, 0x07 }, 1024U, 16U,  64U, 4U, { 0x6A, 0xFF, 0xFF }, 2U, 4500U, 4000U, 9000U, 4500U },
+  { "attiny24", { 0x1E, 0x91, 0x0B }, 2048U, 16U, 128U, 4U, { 0x62, 0xDF, 0xFF }, 3U, 4500U, 4000U, 9000U, 4500U },
+  { "attiny44", { 0x1E, 0x92, 0x07 }, 4096U, 32U, 256U, 4U, { 0x62, 0xDF, 0xFF }, 3U, 4500U, 4000U, 9000U, 4500U },
+  { "attiny84", { 0x1E, 0x93, 0x0C }, 8192U, 32U, 512U, 4U, { 0x62, 0xDF, 0xFF }, 3U, 4500U, 4000U, 9000U, 4500U },
+  { "attiny25", { 0x1E, 0x91, 0x08 }, 2048U, 16U, 128U, 4U, { 0x62, 0xDF, 0xFF }, 3U, 4500U, 4000U, 9000U, 4500U },
+  { "attiny45", { 0x1E, 0x92, 0x06 }, 4096U, 32U, 256U, 4U, { 0x62, 0xDF, 0xFF }, 3U, 4500U, 4000U, 9000U, 4500U },
+  { "attiny85", { 0x1E, 0x93, 0x0B }, 8192U, 32U, 512U, 4U, { 0x62, 0xDF, 0xFF }, 3U, 4500U, 4000U, 9000U, 4500U },
+};
+
+static const char *const tiny_violation_names[TINY_V_COUNT] =
+{
+  "SDI/SII setup", "SDI/SII hold", "SCI high width", "SCI low width",
+  "SCI period", "entry sequence", "instruction while busy", "frame bits"
+};
+
+static sim_pin_model_t tiny_pins;
+
+/**
+  * @brief  xorshift64*, uniform in [0, 1). Seeded, so faulty runs repeat.
+  */
+static double tiny_random(tiny_t *t)
+{
+  t->rng ^= t->rng >> 12;
+  t->rng ^= t->rng << 25;
+  t->rng ^= t->rng >> 27;
+  return (double)((t->rng * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+static void tiny_violation(tiny_t *t, tiny_violation_t v, uint64_t now, uint64_t measured_ps)
+{
+  t->violations[v]++;
+  if (t->logged < TINY_LOG_MAX)
+  {
+    t->logged++;
+    fprintf(stderr, "tiny: %.3f us: %s violation (%.1f ns)\n",
+            (double)now / 1e6, tiny_violation_names[v], (double)measured_ps / 1e3);
+  }
+}
+
+static int tiny_busy(const tiny_t *t, uint64_t now)
+{
+  return now < t->busy_until;
+}
+
+static void tiny_start_busy(tiny_t *t, uint64_t now, uint32_t us)
+{
+  if (t->faults.busy_rate > 0.0 && tiny_random(t) < t->faults.busy_rate)
+  {
+    us += t->faults.busy_ext_us;
+    t->injected_busy++;
+  }
+  t->busy_until = now + (uint64_t)us * 1000000ULL;
+  t->busy_ps += (uint64_t)us * 1000000ULL;
+}
+
+static uint16_t tiny_word_addr(const tiny_t *t)
+{
+  return (uint16_t)(((t->addr_hi << 8) | t->addr_lo) % (t->dev->flash_size / 2U));
+}
+
+static uint16_t tiny_ee_addr(const tiny_t *t)
+{
+  return (uint16_t)(((t->addr_hi << 8) | t->addr_lo) % t->dev->eeprom_size);
+}
+
+/**
+  * @brief  Runs the first half of an instruction pair (0x64, 0x68, ...):
+  *         reads prepare SDO for the next frame.
+  */
+static void tiny_strobe_read(tiny_t *t, uint8_t sii)
+{
+  uint16_t w = tiny_word_addr(t);
+
+  switch (t->cmd)
+  {
+    case 0x02:    /* read flash */
+      t->sdo_byte = (sii == 0x68U) ? t->flash[2U * w] : t->flash[2U * w + 1U];
+      break;
+    case 0x03:    /* read EEPROM */
+      t->sdo_byte = t->eeprom[tiny_ee_addr(t)];
+      break;
+    case 0x04:    /* read fuses and lock */
+      if (sii == 0x68U)
+      {
+        t->sdo_byte = t->fuses[0];
+      }
+      else if (sii == 0x7AU)
+      {
+        t->sdo_byte = t->fuses[1];
+      }
+      else if (sii == 0x6AU)
+      {
+        t->sdo_byte = t->fuses[2];
+      }
+      else
+      {
+        t->sdo_byte = t->lock;
+      }
+      break;
+    case 0x08:    /* read signature and calibration */
+      t->sdo_byte = (sii == 0x68U) ? t->dev->signature[t->addr_lo % 3U] : t->calibration;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+  * @brief  Runs the second half of an instruction pair: latches and writes.
+  */
+static void tiny_strobe_write(tiny_t *t, uint8_t first, uint64_t now)
+{
+  const tiny_device_t *d = t->dev;
+
+  switch (first)
+  {
+    case 0x7DU:   /* latch flash data into the page buffer */
+      t->page_buf[t->addr_lo % d->flash_page] = (uint16_t)(t->data_lo | (t->data_hi << 8));
+      return;
+
+    case 0x6DU:   /* latch EEPROM data into the page buffer */
+      t->eeprom_buf[t->addr_lo % d->eeprom_page] = t->data_lo;
+      t->eeprom_loaded |= (uint8_t)(1U << (t->addr_lo % d->eeprom_page));
+      return;
+
+    case 0x64U:
+      break;
+
+    case 0x74U:   /* write high fuse */
+      if (t->cmd == 0x40U)
+      {
+        t->fuses[1] = t->data_lo;
+        tiny_start_busy(t, now, d->t_wd_fuse_us);
+      }
+      return;
+
+    case 0x66U:   /* write extended fuse */
+      if (t->cmd == 0x40U && d->fuse_count > 2U)
+      {
+        t->fuses[2] = t->data_lo;
+        tiny_start_busy(t, now, d->t_wd_fuse_us);
+      }
+      return;
+
+    default:
+      return;
+  }
+
+  /* 0x64/0x6C: write strobe for the loaded command */
+  switch (t->cmd)
+  {
+    case 0x80U:   /* chip erase, EESAVE (high fuse bit 6) keeps the EEPROM */
+      memset(t->flash, 0xFF, d->flash_size);
+      if ((t->fuses[1] & 0x40U) != 0U)
+      {
+        memset(t->eeprom, 0xFF, d->eeprom_size);
+      }
+      t->lock = 0xFFU;
+      tiny_start_busy(t, now, d->t_wd_erase_us);
+      t->flash_first = 0U;
+      t->flash_done = 0U;
+      t->flash_pages = 0U;
+      break;
+
+    case 0x10U:   /* program flash page: flash bits can only be cleared */
+    {
+      uint16_t base = (uint16_t)(tiny_word_addr(t) & ~(d->flash_page - 1U));
+
+      for (uint16_t i = 0U; i < d->flash_page; i++)
+      {
+        t->flash[2U * (base + i)] &= (uint8_t)t->page_buf[i];
+        t->flash[2U * (base + i) + 1U] &= (uint8_t)(t->page_buf[i] >> 8);
+        t->page_buf[i] = 0xFFFFU;
+      }
+      tiny_start_busy(t, now, d->t_wd_flash_us);
+      t->flash_done = t->busy_until;
+      t->flash_pages++;
+      break;
+    }
+
+    case 0x11U:   /* program EEPROM page: loaded bytes are erased and written */
+    {
+      uint16_t base = (uint16_t)(tiny_ee_addr(t) & ~(d->eeprom_page - 1U));
+
+      for (uint16_t i = 0U; i < d->eeprom_page; i++)
+      {
+        if ((t->eeprom_loaded & (1U << i)) != 0U)
+        {
+          t->eeprom[base + i] = t->eeprom_buf[i];
+        }
+      }
+      t->eeprom_loaded = 0U;
+      tiny_start_busy(t, now, d->t_wd_eeprom_us);
+      break;
+    }
+
+    case 0x40U:   /* write low fuse */
+      t->fuses[0] = t->data_lo;
+      tiny_start_busy(t, now, d->t_wd_fuse_us);
+      break;
+
+    case 0x20U:   /* write lock bits, they can only be programmed */
+      t->lock &= (uint8_t)(t->data_lo | 0xFCU);
+      tiny_start_busy(t, now, d->t_wd_fuse_us);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+  * @brief  Decodes one complete 11-bit frame.
+  */
+static void tiny_instruction(tiny_t *t, uint64_t now)
+{
+  uint8_t sdi = (uint8_t)(t->sdi_shift >> 2);
+  uint8_t sii = (uint8_t)(t->sii_shift >> 2);
+
+  t->frames++;
+  if (t->faults.drop_rate > 0.0 && tiny_random(t) < t->faults.drop_rate)
+  {
+    t->injected_drops++;
+    return;
+  }
+  if (((t->sdi_shift | t->sii_shift) & 0x403U) != 0U)
+  {
+    tiny_violation(t, TINY_V_FRAME, now, 0U);
+  }
+
+  switch (sii)
+  {
+    case 0x4CU:
+      t->cmd = sdi;
+      if (sdi == 0x10U && t->flash_first == 0U)
+      {
+        t->flash_first = now;
+      }
+      break;
+    case 0x0CU:
+      t->addr_lo = sdi;
+      break;
+    case 0x1CU:
+      t->addr_hi = sdi;
+      break;
+    case 0x2CU:
+      t->data_lo = sdi;
+      break;
+    case 0x3CU:
+      t->data_hi = sdi;
+      break;
+    case 0x64U: case 0x74U: case 0x66U: case 0x68U: case 0x78U:
+    case 0x7AU: case 0x6AU: case 0x6DU: case 0x7DU:
+      t->strobe = sii;
+      tiny_strobe_read(t, sii);
+      break;
+    case 0x6CU: case 0x7CU: case 0x6EU: case 0x7EU:
+      tiny_strobe_write(t, t->strobe, now);
+      t->strobe = 0U;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+  * @brief  SDO direction changes are CRL writes the model is not told about,
+  *         so the release is noticed at the next port access.
+  */
+static void tiny_check_release(tiny_t *t, uint64_t now, uint32_t outputs)
+{
+  if (t->progmode && !t->sdo_released && (outputs & HVSP_SDO) == 0U)
+  {
+    t->sdo_released = 1;
+    if (now - t->t_12v < TINY_PROG_ENABLE_HOLD_PS)
+    {
+      tiny_violation(t, TINY_V_ENTRY, now, now - t->t_12v);
+    }
+  }
+}
+
+static void tiny_sci_rise(tiny_t *t, uint64_t now)
+{
+  uint32_t lv = t->levels;
+
+  if (now - t->t_data_change < TINY_T_IVSH_PS)
+  {
+    tiny_violation(t, TINY_V_SETUP, now, now - t->t_data_change);
+  }
+  if (t->t_sci_fall != 0U && now - t->t_sci_fall < TINY_T_SLSH_PS)
+  {
+    tiny_violation(t, TINY_V_SCI_LOW, now, now - t->t_sci_fall);
+  }
+  if (t->t_sci_rise != 0U && now - t->t_sci_rise < TINY_T_SCI_MIN_PS)
+  {
+    tiny_violation(t, TINY_V_SCI_PERIOD, now, now - t->t_sci_rise);
+  }
+  if (t->progmode && t->t_sci_rise < t->t_12v && now - t->t_12v < TINY_FIRST_INSTR_PS)
+  {
+    tiny_violation(t, TINY_V_ENTRY, now, now - t->t_12v);
+  }
+  t->t_sci_rise = now;
+
+  if (!t->progmode)
+  {
+    return;
+  }
+  if (tiny_busy(t, now))
+  {
+    tiny_violation(t, TINY_V_BUSY, now, t->busy_until - now);
+  }
+
+  t->sdi_shift = (uint16_t)((t->sdi_shift << 1) | ((lv & HVSP_SDI) ? 1U : 0U));
+  t->sii_shift = (uint16_t)((t->sii_shift << 1) | ((lv & HVSP_SII) ? 1U : 0U));
+  if (t->bits == 0U && t->faults.sdo_ber > 0.0)
+  {
+    /* Decide now which of this frame's eight SDO data bits arrive flipped */
+    t->sdo_flip = 0U;
+    for (uint32_t i = 0U; i < 8U; i++)
+    {
+      if (tiny_random(t) < t->faults.sdo_ber)
+      {
+        t->sdo_flip |= (uint8_t)(1U << i);
+        t->injected_flips++;
+      }
+    }
+  }
+  if (++t->bits == 11U)
+  {
+    tiny_instruction(t, now);
+    t->bits = 0U;
+  }
+}
+
+static void tiny_output(void *ctx, uint64_t now, uint32_t levels, uint32_t outputs)
+{
+  tiny_t *t = ctx;
+  uint32_t changed = levels ^ t->levels;
+
+  t->levels = levels;
+  t->outputs = outputs;
+
+  if ((changed & HVSP_VCC) != 0U)
+  {
+    t->powered = (levels & HVSP_VCC) != 0U;
+    t->progmode = 0;
+    t->sdo_released = 0;
+    t->t_vcc = now;
+    t->bits = 0U;
+  }
+
+  if ((changed & HVSP_12V) != 0U)
+  {
+    if ((levels & HVSP_12V) != 0U && t->powered)
+    {
+      uint64_t dt = now - t->t_vcc;
+
+      /* Prog_enable (SDI, SII, SDO) must read 000 when 12 V arrives */
+      if (dt < TINY_VCC_TO_12V_MIN_PS || dt > TINY_VCC_TO_12V_MAX_PS ||
+          (levels & (HVSP_SDI | HVSP_SII | HVSP_SDO)) != 0U || (outputs & HVSP_SDO) == 0U)
+      {
+        tiny_violation(t, TINY_V_ENTRY, now, dt);
+      }
+      else
+      {
+        t->progmode = 1;
+      }
+      t->t_12v = now;
+      t->bits = 0U;
+      t->cmd = 0U;
+      t->strobe = 0U;
+    }
+    else
+    {
+      t->progmode = 0;
+    }
+  }
+
+  tiny_check_release(t, now, outputs);
+
+  if ((changed & (HVSP_SDI | HVSP_SII)) != 0U)
+  {
+    if (t->t_sci_rise != 0U && now - t->t_sci_rise < TINY_T_SHIX_PS)
+    {
+      tiny_violation(t, TINY_V_HOLD, now, now - t->t_sci_rise);
+    }
+    t->t_data_change = now;
+  }
+
+  if ((changed & HVSP_SCI) != 0U)
+  {
+    if ((levels & HVSP_SCI) != 0U)
+    {
+      tiny_sci_rise(t, now);
+    }
+    else
+    {
+      if (now - t->t_sci_rise < TINY_T_SHSL_PS)
+      {
+        tiny_violation(t, TINY_V_SCI_HIGH, now, now - t->t_sci_rise);
+      }
+      t->t_sci_fall = now;
+    }
+  }
+}
+
+/**
+  * @brief  SDO: low while busy, the output byte MSB first during the data
+  *         bits of a frame, high (ready) otherwise.
+  */
+static uint32_t tiny_input(void *ctx, uint64_t now, uint32_t *driven)
+{
+  tiny_t *t = ctx;
+
+  tiny_check_release(t, now, sim_gpio_outputs(HVSP_PORT));
+  if (!t->progmode || !t->sdo_released)
+  {
+    *driven = 0U;
+    return 0U;
+  }
+  *driven = HVSP_SDO;
+  if (tiny_busy(t, now))
+  {
+    return 0U;
+  }
+  if (t->bits >= 1U && t->bits <= 8U)
+  {
+    return (((t->sdo_byte ^ t->sdo_flip) >> (8U - t->bits)) & 1U) ? HVSP_SDO : 0U;
+  }
+  return HVSP_SDO;
+}
+
+const tiny_device_t *tiny_find(const char *name)
+{
+  for (uint32_t i = 0U; i < sizeof(tiny_devices) / sizeof(tiny_devices[0]); i++)
+  {
+    if (strcmp(tiny_devices[i].name, name) == 0)
+    {
+      return &tiny_devices[i];
+    }
+  }
+  return 0;
+}
+
+/**
+  * @brief  Puts a factory-fresh device on the bench: erased memories,
+  *         default fuses, unpowered.
+  */
+void tiny_init(tiny_t *t, const tiny_device_t *dev)
+{
+  memset(t, 0, sizeof(*t));
+  t->dev = dev;
+  memset(t->flash, 0xFF, sizeof(t->flash));
+  memset(t->eeprom, 0xFF, sizeof(t->eeprom));
+  memset(t->page_buf, 0xFF, sizeof(t->page_buf));
+  memset(t->eeprom_buf, 0xFF, sizeof(t->eeprom_buf));
+  memcpy(t->fuses, dev->fuses, sizeof(t->fuses));
+  t->lock = 0xFFU;
+  t->calibration = 0x5AU;
+}
+
+void tiny_attach(tiny_t *t)
+{
+  tiny_pins.port = HVSP_PORT;
+  tiny_pins.output = tiny_output;
+  tiny_pins.input = tiny_input;
+  tiny_pins.ctx = t;
+  sim_attach(&tiny_pins);
+}
+
+/**
+  * @brief  Parses a fault profile, e.g. "sdo=1e-4,busy=0.05:8000,drop=1e-4,seed=7":
+  *         SDO bit error rate, probability and length (us) of a busy
+  *         extension, frame drop rate, random seed.
+  * @retval 0 on success, -1 on a malformed spec
+  */
+int tiny_parse_faults(tiny_faults_t *f, const char *spec)
+{
+  memset(f, 0, sizeof(*f));
+  f->seed = 1U;
+
+  while (*spec != '\0')
+  {
+    char *end;
+
+    if (strncmp(spec, "sdo=", 4) == 0)
+    {
+      f->sdo_ber = strtod(spec + 4, &end);
+    }
+    else if (strncmp(spec, "busy=", 5) == 0)
+    {
+      f->busy_rate = strtod(spec + 5, &end);
+      if (*end != ':')
+      {
+        return -1;
+      }
+      f->busy_ext_us = (uint32_t)strtoul(end + 1, &end, 10);
+    }
+    else if (strncmp(spec, "drop=", 5) == 0)
+    {
+      f->drop_rate = strtod(spec + 5, &end);
+    }
+    else if (strncmp(spec, "seed=", 5) == 0)
+    {
+      f->seed = strtoull(spec + 5, &end, 10);
+    }
+    else
+    {
+      return -1;
+    }
+
+    if (*end == ',')
+    {
+      end++;
+    }
+    else if (*end != '\0')
+    {
+      return -1;
+    }
+    spec = end;
+  }
+  return 0;
+}
+
+void tiny_set_faults(tiny_t *t, const tiny_faults_t *f)
+{
+  t->faults = *f;
+  t->rng = (f->seed != 0U) ? f->seed : 1U;
+}
+
+uint32_t tiny_violation_total(const tiny_t *t)
+{
+  uint32_t total = 0U;
+
+  for (uint32_t i = 0U; i < TINY_V_COUNT; i++)
+  {
+    total += t->violations[i];
+  }
+  return total;
+}
+
+void tiny_report(const tiny_t *t, FILE *f)
+{
+  fprintf(f, "tiny: %s, %llu frames, %.3f ms busy, %u timing violations\n",
+          t->dev->name, (unsigned long long)t->frames, (double)t->busy_ps / 1e9,
+          tiny_violation_total(t));
+  for (uint32_t i = 0U; i < TINY_V_COUNT; i++)
+  {
+    if (t->violations[i] != 0U)
+    {
+      fprintf(f, "tiny:   %-24s %u\n", tiny_violation_names[i], t->violations[i]);
+    }
+  }
+  if (t->flash_pages != 0U)
+  {
+    fprintf(f, "tiny: flash programmed in %.1f us, %u pages\n",
+            (double)(t->flash_done - t->flash_first) / 1e6, t->flash_pages);
+  }
+  if (t->injected_flips != 0U || t->injected_busy != 0U || t->injected_drops != 0U)
+  {
+    fprintf(f, "tiny: injected %u SDO bit flips, %u busy extensions, %u dropped frames\n",
+            t->injected_flips, t->injected_busy, t->injected_drops);
+  }
+}
@@ -0,0 +1,144 @@
+/**
+  ******************************************************************************
+  * @file    tiny.h
+  * @brief   Host build: behavioural ATtiny HVSP target.
+  *
+  *          Follows the SDI/SII/SCI/SDO, VCC and 12 V lines of board.h,
+  *          decodes the datasheet instruction set and keeps flash, EEPROM,
+  *          fuses, lock bits, signature and calibration byte. Programming
+  *          operations keep SDO low for the datasheet write times. Every
+  *          setup/hold, pulse-width, clock-period and entry-sequence
+  *          violation is counted and the first ones are logged.
+  *
+  *          Faults can be injected at configurable rates: flipped SDO data
+  *          bits, busy periods stretched past the datasheet time, and whole
+  *          frames the target ignores.
+  ******************************************************************************
+  */
+
+#ifndef __TINY_H
+#define __TINY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define TINY_FLASH_MAX      8192U
+#define TINY_EEPROM_MAX     512U
+
+/* Timing limits, ATtiny25/45/85 datasheet "High-voltage Serial Programming
+   Characteristics", in ps */
+#define TINY_T_SHSL_PS      125000ULL   /* SCI high pulse width         */
+#define TINY_T_SLSH_PS      125000ULL   /* SCI low pulse width          */
+#define TINY_T_IVSH_PS      50000ULL    /* SDI/SII setup to SCI high    */
+#define TINY_T_SHIX_PS      50000ULL    /* SDI/SII hold after SCI high  */
+#define TINY_T_SCI_MIN_PS   (TINY_T_SHSL_PS + TINY_T_SLSH_PS)
+
+/* Entry sequence limits, in ps */
+#define TINY_VCC_TO_12V_MIN_PS      20000000ULL
+#define TINY_VCC_TO_12V_MAX_PS      60000000ULL
+#define TINY_PROG_ENABLE_HOLD_PS    10000000ULL
+#define TINY_FIRST_INSTR_PS         300000000ULL   /* from 12 V, lenient */
+
+typedef struct
+{
+  const char *name;
+  uint8_t signature[3];
+  uint16_t flash_size;        /*!< bytes */
+  uint16_t flash_page;        /*!< words */
+  uint16_t eeprom_size;       /*!< bytes */
+  uint16_t eeprom_page;       /*!< bytes */
+  uint8_t fuses[3];           /*!< factory low, high, extended */
+  uint8_t fuse_count;
+  uint32_t t_wd_flash_us;
+  uint32_t t_wd_eeprom_us;
+  uint32_t t_wd_erase_us;
+  uint32_t t_wd_fuse_us;
+} tiny_device_t;
+
+typedef enum
+{
+  TINY_V_SETUP = 0,           /*!< SDI/SII changed too close before SCI rise */
+  TINY_V_HOLD,                /*!< SDI/SII changed too soon after SCI rise   */
+  TINY_V_SCI_HIGH,            /*!< SCI high pulse too short                  */
+  TINY_V_SCI_LOW,             /*!< SCI low pulse too short                   */
+  TINY_V_SCI_PERIOD,          /*!< rising edges too close together           */
+  TINY_V_ENTRY,               /*!< power-up / 12 V / Prog_enable sequence    */
+  TINY_V_BUSY,                /*!< instruction clocked in while busy         */
+  TINY_V_FRAME,               /*!< start or stop bit not 0                   */
+  TINY_V_COUNT
+} tiny_violation_t;
+
+typedef struct
+{
+  double sdo_ber;             /*!< probability of a flipped SDO data bit    */
+  double busy_rate;           /*!< probability a write stays busy longer     */
+  uint32_t busy_ext_us;       /*!< how much longer                           */
+  double drop_rate;           /*!< probability a frame is ignored            */
+  uint64_t seed;
+} tiny_faults_t;
+
+typedef struct
+{
+  const tiny_device_t *dev;
+  tiny_faults_t faults;
+  uint64_t rng;
+
+  /* Memories */
+  uint8_t flash[TINY_FLASH_MAX];
+  uint8_t eeprom[TINY_EEPROM_MAX];
+  uint8_t fuses[3];
+  uint8_t lock;
+  uint8_t calibration;
+  uint16_t page_buf[64];
+  uint8_t eeprom_buf[8];
+  uint8_t eeprom_loaded;
+
+  /* Pins and mode */
+  uint32_t levels;
+  uint32_t outputs;
+  int powered;
+  int progmode;
+  int sdo_released;
+  uint64_t t_vcc;
+  uint64_t t_12v;
+  uint64_t t_sci_rise;
+  uint64_t t_sci_fall;
+  uint64_t t_data_change;
+  uint64_t busy_until;
+
+  /* Serial interface */
+  uint32_t bits;
+  uint16_t sdi_shift;
+  uint16_t sii_shift;
+  uint8_t sdo_byte;
+  uint8_t sdo_flip;
+  uint8_t cmd;
+  uint8_t addr_lo;
+  uint8_t addr_hi;
+  uint8_t data_lo;
+  uint8_t data_hi;
+  uint8_t strobe;
+
+  /* Statistics */
+  uint32_t violations[TINY_V_COUNT];
+  uint32_t logged;
+  uint64_t frames;
+  uint64_t busy_ps;
+  uint64_t flash_first;     /*!< first Write Flash command since the last
+                                 chip erase, ps                           */
+  uint64_t flash_done;      /*!< end of the last flash page write, ps     */
+  uint32_t flash_pages;
+  uint32_t injected_flips;
+  uint32_t injected_busy;
+  uint32_t injected_drops;
+} tiny_t;
+
+const tiny_device_t *tiny_find(const char *name);
+void tiny_init(tiny_t *t, const tiny_device_t *dev);
+int tiny_parse_faults(tiny_faults_t *f, const char *spec);
+void tiny_set_faults(tiny_t *t, const tiny_faults_t *f);
+void tiny_attach(tiny_t *t);
+uint32_t tiny_violation_total(const tiny_t *t);
+void tiny_report(const tiny_t *t, FILE *f);
+
+#endif /* __TINY_H */
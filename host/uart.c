@@ -0,0 +1,94 @@
+/**
+  ******************************************************************************
+  * @file    uart.c
+  * @brief   Host build: a host UART transmitter on the USART1 RX pin (PA10),
+  *          for checking autobaud against the line.
+  *
+  *          The line idles high and sends one 8N1 character. The check runs
+  *          the firmware's autobaud code as EXTI15_10_IRQHandler() does,
+  *          entered SIM_IRQ_ENTRY_CYCLES after the start bit's edge.
+  ******************************************************************************
+  */
+
+#include <stdio.h>
+
+#include "uart.h"
+#include "autobaud.h"
+#include "board.h"
+#include "sim.h"
+
+static sim_pin_model_t uart_model;
+
+static uint32_t uart_input(void *ctx, uint64_t t_ps, uint32_t *driven)
+{
+  const uart_line_t *u = ctx;
+  uint64_t bit;
+
+  *driven = LINK_RX;
+  if (t_ps < u->t_start)
+  {
+    return LINK_RX;
+  }
+  bit = (t_ps - u->t_start) / u->bit_ps;
+  if (bit == 0U)
+  {
+    return 0U;                                      /* start bit */
+  }
+  if (bit <= 8U)
+  {
+    return ((u->byte >> (bit - 1U)) & 1U) != 0U ? LINK_RX : 0U;
+  }
+  return LINK_RX;                                   /* stop bit, idle */
+}
+
+/**
+  * @brief  Schedules one character.
+  * @param  u: line
+  * @param  byte: character, LSB first
+  * @param  baudrate: line rate in bit/s
+  * @param  t_start: simulated time of the start bit's edge, ps
+  * @retval None
+  */
+void uart_send(uart_line_t *u, uint8_t byte, uint32_t baudrate, uint64_t t_start)
+{
+  u->t_start = t_start;
+  u->bit_ps = 1000000000000ULL / baudrate;
+  u->byte = byte;
+}
+
+void uart_attach(uart_line_t *u)
+{
+  uart_model.port = LINK_RX_PORT;
+  uart_model.input = uart_input;
+  uart_model.ctx = u;
+  sim_attach(&uart_model);
+}
+
+/**
+  * @brief  Sends a 0x55 sync byte at the given rate and measures it the way
+  *         the start edge interrupt does. Call after delay_init().
+  * @param  baudrate: line rate in bit/s
+  * @retval 0 when autobaud finds the BRR of that rate, -1 if not
+  */
+int uart_autobaud_check(uint32_t baudrate)
+{
+  static uart_line_t line;
+  uint32_t expected = (SystemCoreClock + baudrate / 2U) / baudrate;
+  autobaud_sample_t sync;
+  uint32_t cycles;
+  uint32_t brr;
+
+  uart_send(&line, 0x55U, baudrate, sim_now_ps() + 10000000U);
+  uart_attach(&line);
+  autobaud_arm();
+
+  sim_advance_ps(line.t_start - sim_now_ps());
+  sim_advance_cycles(SIM_IRQ_ENTRY_CYCLES);
+  autobaud_sample(&sync);
+  cycles = autobaud_measure(&sync);
+  brr = autobaud_brr(cycles);
+
+  fprintf(stderr, "autobaud: %u baud, BRR %u, measured %u (%u cycles for %u bits)\n",
+          baudrate, expected, brr, cycles, AUTOBAUD_BITS);
+  return (brr == expected) ? 0 : -1;
+}
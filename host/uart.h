@@ -0,0 +1,25 @@
+/**
+  ******************************************************************************
+  * @file    uart.h
+  * @brief   Host build: a host UART transmitter on the USART1 RX pin (PA10),
+  *          for checking autobaud against the line.
+  ******************************************************************************
+  */
+
+#ifndef __UART_H
+#define __UART_H
+
+#include <stdint.h>
+
+typedef struct
+{
+  uint64_t t_start;           /*!< simulated time of the start bit's edge, ps */
+  uint64_t bit_ps;
+  uint8_t byte;
+} uart_line_t;
+
+void uart_send(uart_line_t *u, uint8_t byte, uint32_t baudrate, uint64_t t_start);
+void uart_attach(uart_line_t *u);
+int uart_autobaud_check(uint32_t baudrate);
+
+#endif /* __UART_H */
@@ -0,0 +1,237 @@
+/**
+  ******************************************************************************
+  * @file    vcd.c
+  * @brief   Host build: Value Change Dump recorder and wire analysis for the
+  *          HVSP pins.
+  ******************************************************************************
+  */
+
+#include <string.h>
+
+#include "vcd.h"
+#include "board.h"
+#include "sim.h"
+
+static const struct
+{
+  uint32_t mask;
+  char id;
+  const char *name;
+} vcd_pins[] =
+{
+  { HVSP_SDI, '!', "SDI" },
+  { HVSP_SII, '"', "SII" },
+  { HVSP_SDO, '#', "SDO" },
+  { HVSP_SCI, '$', "SCI" },
+  { HVSP_VCC, '%', "VCC" },
+  { HVSP_12V, '&', "HV12" },
+};
+
+#define VCD_PIN_COUNT   (sizeof(vcd_pins) / sizeof(vcd_pins[0]))
+
+static sim_pin_model_t vcd_model;
+
+static void vcd_frame_end(vcd_t *v)
+{
+  v->in_frame = 0;
+  v->frames++;
+  v->t_frame_end = v->t_fall;
+  v->frame_time += v->t_fall - v->t_frame_start;
+}
+
+static void vcd_frame_start(vcd_t *v, uint64_t now)
+{
+  if (v->frames != 0U)
+  {
+    uint64_t gap = now - v->t_frame_end;
+    uint64_t mean = (v->periods != 0U) ? v->period_sum / v->periods : 0U;
+
+    v->gaps++;
+    v->gap_sum += gap;
+    if (gap > v->gap_max)
+    {
+      v->gap_max = gap;
+    }
+    if (v->busy_in_gap)
+    {
+      /* The target was programming: the wait is the datasheet's, not ours */
+      v->busy_gaps++;
+      v->busy_gap_sum += gap;
+    }
+    else if (gap > mean * VCD_IDLE_GAP_PERIODS)
+    {
+      v->idle_gaps++;
+      v->idle_gap_sum += gap;
+    }
+  }
+  else
+  {
+    v->t_first_frame = now;
+  }
+  v->in_frame = 1;
+  v->busy_in_gap = 0;
+  v->t_frame_start = now;
+}
+
+/**
+  * @brief  Follows SCI to find frames: 11 rising edges each, counted from
+  *         the moment 12 V is applied.
+  */
+static void vcd_analyse(vcd_t *v, uint64_t now, uint32_t levels, uint32_t changed)
+{
+  if ((changed & HVSP_12V) != 0U)
+  {
+    v->rises = 0U;
+    v->in_frame = 0;
+  }
+  if ((levels & HVSP_12V) == 0U)
+  {
+    return;
+  }
+
+  if ((changed & HVSP_SCI) != 0U && (levels & HVSP_SCI) != 0U)
+  {
+    if ((v->rises % 11U) == 0U)
+    {
+      vcd_frame_start(v, now);
+    }
+    else
+    {
+      uint64_t period = now - v->t_rise;
+
+      v->periods++;
+      v->period_sum += period;
+      if (v->period_min == 0U || period < v->period_min)
+      {
+        v->period_min = period;
+      }
+      v->low_sum += now - v->t_fall;
+    }
+    v->rises++;
+    v->t_rise = now;
+  }
+  else if ((changed & HVSP_SCI) != 0U && v->in_frame)
+  {
+    v->t_fall = now;
+    v->high_sum += now - v->t_rise;
+    if ((v->rises % 11U) == 0U)
+    {
+      vcd_frame_end(v);
+    }
+  }
+
+  /* Between frames SDO low is the target's busy signal */
+  if ((levels & HVSP_SDO) == 0U && !v->in_frame)
+  {
+    v->busy_in_gap = 1;
+  }
+}
+
+static void vcd_sample(void *ctx, uint64_t now, uint32_t levels)
+{
+  vcd_t *v = ctx;
+  uint32_t changed;
+
+  levels &= HVSP_PINS;
+  changed = levels ^ v->levels;
+  if (v->started && changed == 0U)
+  {
+    return;
+  }
+
+  if (v->f != 0)
+  {
+    fprintf(v->f, "#%llu\n", (unsigned long long)now);
+    for (uint32_t i = 0U; i < VCD_PIN_COUNT; i++)
+    {
+      if (!v->started || (changed & vcd_pins[i].mask) != 0U)
+      {
+        fprintf(v->f, "%c%c\n", (levels & vcd_pins[i].mask) ? '1' : '0', vcd_pins[i].id);
+      }
+    }
+  }
+  v->started = 1;
+  v->levels = levels;
+
+  vcd_analyse(v, now, levels, changed);
+}
+
+/**
+  * @brief  Starts a recording.
+  * @param  path: VCD file to write, or NULL for the analysis alone
+  * @retval 0 on success, -1 if the file cannot be created
+  */
+int vcd_open(vcd_t *v, const char *path)
+{
+  memset(v, 0, sizeof(*v));
+  if (path == 0)
+  {
+    return 0;
+  }
+
+  v->f = fopen(path, "w");
+  if (v->f == 0)
+  {
+    return -1;
+  }
+  fprintf(v->f, "$version stm32 hvsp programmer host build $end\n");
+  fprintf(v->f, "$timescale 1 ps $end\n");
+  fprintf(v->f, "$scope module hvsp $end\n");
+  for (uint32_t i = 0U; i < VCD_PIN_COUNT; i++)
+  {
+    fprintf(v->f, "$var wire 1 %c %s $end\n", vcd_pins[i].id, vcd_pins[i].name);
+  }
+  fprintf(v->f, "$upscope $end\n$enddefinitions $end\n");
+  return 0;
+}
+
+void vcd_attach(vcd_t *v)
+{
+  vcd_model.port = HVSP_PORT;
+  vcd_model.sample = vcd_sample;
+  vcd_model.ctx = v;
+  sim_attach(&vcd_model);
+}
+
+void vcd_close(vcd_t *v)
+{
+  if (v->f != 0)
+  {
+    fprintf(v->f, "#%llu\n", (unsigned long long)sim_now_ps());
+    fclose(v->f);
+    v->f = 0;
+  }
+}
+
+/**
+  * @brief  Prints the wire checks. Utilisation is frame time over the span
+  *         from the first frame to the last; the second figure leaves out
+  *         gaps where the target held SDO low (busy).
+  */
+void vcd_report(const vcd_t *v, FILE *f)
+{
+  uint64_t span = v->t_frame_end - v->t_first_frame;
+  uint64_t active = span - v->busy_gap_sum;
+
+  if (v->frames == 0U || v->periods == 0U)
+  {
+    fprintf(f, "vcd: no HVSP frames\n");
+    return;
+  }
+
+  fprintf(f, "vcd: %llu frames, SCI %.3f MHz mean, %.3f MHz peak, duty %.1f %%\n",
+          (unsigned long long)v->frames,
+          1e6 / ((double)v->period_sum / (double)v->periods),
+          1e6 / (double)v->period_min,
+          100.0 * (double)v->high_sum / (double)(v->high_sum + v->low_sum));
+  fprintf(f, "vcd: frame %.3f us mean, gap %.3f us mean, %.3f us max\n",
+          (double)v->frame_time / (double)v->frames / 1e6,
+          (v->gaps != 0U) ? (double)v->gap_sum / (double)v->gaps / 1e6 : 0.0,
+          (double)v->gap_max / 1e6);
+  fprintf(f, "vcd: %llu busy gaps (%.3f ms), %llu idle gaps (%.3f ms)\n",
+          (unsigned long long)v->busy_gaps, (double)v->busy_gap_sum / 1e9,
+          (unsigned long long)v->idle_gaps, (double)v->idle_gap_sum / 1e9);
+  fprintf(f, "vcd: wire utilisation %.1f %% (%.1f %% excluding busy waits)\n",
+          (span != 0U) ? 100.0 * (double)v->frame_time / (double)span : 0.0,
+          (active != 0U) ? 100.0 * (double)v->frame_time / (double)active : 0.0);
+}
@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file    vcd.h
+  * @brief   Host build: Value Change Dump recorder and wire analysis for the
+  *          HVSP pins.
+  *
+  *          Every pin transition is written with its simulated time stamp
+  *          (1 ps resolution) and fed to the checks: SCI frequency and duty
+  *          cycle inside frames, gaps between frames, and wire utilisation,
+  *          the share of the session the wire spends clocking frames.
+  ******************************************************************************
+  */
+
+#ifndef __VCD_H
+#define __VCD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Gaps longer than this many mean SCI periods count as idle */
+#define VCD_IDLE_GAP_PERIODS    4U
+
+typedef struct
+{
+  FILE *f;
+  uint32_t levels;
+  int started;
+
+  /* Frame tracking */
+  uint32_t rises;             /*!< SCI rising edges since 12 V came up */
+  uint64_t t_rise;
+  uint64_t t_fall;
+  uint64_t t_frame_start;
+  uint64_t t_frame_end;
+  uint64_t t_first_frame;
+  int in_frame;
+  int busy_in_gap;            /*!< SDO seen low since the last frame */
+
+  /* Statistics, times in ps */
+  uint64_t frames;
+  uint64_t periods;
+  uint64_t period_sum;
+  uint64_t period_min;
+  uint64_t high_sum;
+  uint64_t low_sum;
+  uint64_t frame_time;
+  uint64_t gaps;
+  uint64_t gap_sum;
+  uint64_t gap_max;
+  uint64_t busy_gaps;
+  uint64_t busy_gap_sum;
+  uint64_t idle_gaps;
+  uint64_t idle_gap_sum;
+} vcd_t;
+
+int vcd_open(vcd_t *v, const char *path);
+void vcd_attach(vcd_t *v);
+void vcd_close(vcd_t *v);
+void vcd_report(const vcd_t *v, FILE *f);
+
+#endif /* __VCD_H */
@@ -0,0 +1,26 @@
+/**
+  ******************************************************************************
+  * @file    arena.h
+  * @brief   Session arena: bump allocation from the RAM left between the
+  *          static data and the stack, released in O(1) at session end.
+  ******************************************************************************
+  */
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stdint.h>
+
+/* Allocation granularity, enough for any scalar and for LDM/STM bursts */
+#define ARENA_ALIGN       8U
+
+/* Arena level to return to, from arena_mark() */
+typedef uint32_t arena_mark_t;
+
+void arena_init(void);
+void *arena_alloc(uint32_t size);
+arena_mark_t arena_mark(void);
+void arena_release(arena_mark_t mark);
+uint8_t arena_cmd_stats(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+#endif /* __ARENA_H */
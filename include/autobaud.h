@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    autobaud.h
+  * @brief   Line rate measurement from a 0x55 sync byte on the USART1 RX
+  *          pin (PA10), for CMD_SET_BAUD with rate 0.
+  ******************************************************************************
+  */
+
+#ifndef __AUTOBAUD_H
+#define __AUTOBAUD_H
+
+#include <stdint.h>
+#include "board.h"
+#include "delay.h"
+#include "gpio.h"
+
+/* Falling edges of a 0x55 frame after the start bit: data bits 1, 3, 5 and
+   7, six bit times apart. The start bit's edge only raises the interrupt,
+   whose entry latency would bias the count */
+#define AUTOBAUD_EDGES    4U
+#define AUTOBAUD_BITS     6U
+
+/* The RX pin and the time, taken as the start bit's interrupt is entered */
+typedef struct
+{
+  uint32_t level;
+  uint32_t start;
+} autobaud_sample_t;
+
+/**
+  * @brief  First thing in the start edge interrupt: at 4.5 Mbaud the first
+  *         counted edge comes two bit times, 32 core cycles, after the start
+  *         edge, and the entry has used 12 of them.
+  */
+static inline void autobaud_sample(autobaud_sample_t *s)
+{
+  s->level = gpio_read(LINK_RX_PORT, LINK_RX);
+  s->start = delay_now();
+}
+
+void autobaud_arm(void);
+uint32_t autobaud_measure(const autobaud_sample_t *s);
+uint32_t autobaud_brr(uint32_t cycles);
+
+#endif /* __AUTOBAUD_H */
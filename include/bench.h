@@ -0,0 +1,16 @@
+/**
+  ******************************************************************************
+  * @file    bench.h
+  * @brief   Firmware micro-benchmarks for the SIM_BENCH build, run on a
+  *          Cortex-M3 emulator (make sim) or on the board under a debugger
+  *          with semihosting.
+  ******************************************************************************
+  */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+/* Runs every benchmark, prints the results and exits through semihosting */
+void bench_run(void) __attribute__((noreturn));
+
+#endif /* __BENCH_H */
@@ -0,0 +1,47 @@
+/**
+  ******************************************************************************
+  * @file    board.h
+  * @brief   Programmer wiring.
+  *
+  *          HVSP lines to the ATtiny (8-pin package pin numbers in brackets)
+  *          and the target power switches, all on GPIOA:
+  *
+  *            PA0  SDI  -> PB0 (5)     PA3  SCI  -> PB3 (2)
+  *            PA1  SII  -> PB1 (6)     PA4  VCC switch, high = target powered
+  *            PA2  SDO  <- PB2 (7)     PA5  12 V switch, high = 12 V on RESET (1)
+  *
+  *          The host link uses USART1 on PA9/PA10, see usart.h, and the
+  *          USB-serial bridge's DTR# output on PA8 (low while the host has
+  *          the port open).
+  ******************************************************************************
+  */
+
+#ifndef __BOARD_H
+#define __BOARD_H
+
+#include "stm32f1xx.h"
+
+#define HVSP_PORT         GPIOA
+#define HVSP_SDI          (1UL << 0)
+#define HVSP_SII          (1UL << 1)
+#define HVSP_SDO          (1UL << 2)
+#define HVSP_SCI          (1UL << 3)
+#define HVSP_VCC          (1UL << 4)
+#define HVSP_12V          (1UL << 5)
+
+#define HVSP_PINS         (HVSP_SDI | HVSP_SII | HVSP_SDO | HVSP_SCI | HVSP_VCC | HVSP_12V)
+
+/* CRL nibbles for PA0..PA5 */
+#define HVSP_CRL_MASK     0x00FFFFFFUL
+#define HVSP_CRL_OUT      0x00333333UL    /* all push-pull 50 MHz, SDO driven for Prog_enable */
+#define HVSP_CRL_SDO_IN   0x00333833UL    /* SDO as input with pull-down */
+
+/* USART1 RX, also timed directly for autobaud (EXTI line 10) */
+#define LINK_RX_PORT      GPIOA
+#define LINK_RX           (1UL << 10)
+
+/* DTR# from the USB-serial bridge, input with pull-up, EXTI line 8 */
+#define LINK_DTR_PORT     GPIOA
+#define LINK_DTR          (1UL << 8)
+
+#endif /* __BOARD_H */
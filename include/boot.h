@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file    boot.h
+  * @brief   Boot-phase timestamps taken from the DWT cycle counter.
+  *
+  *          Reset_Handler starts CYCCNT before anything else and the startup
+  *          code and main() stamp each phase once. The record lives in
+  *          .noinit and can be fetched with CMD_GET_BOOT_TIMES.
+  ******************************************************************************
+  */
+
+#ifndef __BOOT_H
+#define __BOOT_H
+
+#include <stdint.h>
+
+/* Phases in the order they complete. Everything up to and including
+   BOOT_PHASE_CLOCK_LOCK runs from the 8 MHz HSI, the rest from HCLK. */
+typedef enum
+{
+  BOOT_PHASE_SYSTEM_INIT = 0,   /*!< SystemInit() returned                  */
+  BOOT_PHASE_DATA_COPY,         /*!< .data copied from flash                */
+  BOOT_PHASE_BSS_ZERO,          /*!< .bss cleared                           */
+  BOOT_PHASE_STACK_PAINT,       /*!< stack reservation painted, see stack.h */
+  BOOT_PHASE_CLOCK_LOCK,        /*!< PLL locked and selected as SYSCLK      */
+  BOOT_PHASE_LINK_UP,           /*!< host link configured and listening     */
+  BOOT_PHASE_FIRST_CMD,         /*!< first valid host command dispatched    */
+  BOOT_PHASE_COUNT
+} boot_phase_t;
+
+typedef struct
+{
+  uint32_t stamped;                     /*!< bit n set when phase n is valid */
+  uint32_t cycles[BOOT_PHASE_COUNT];    /*!< CYCCNT at the end of each phase */
+} boot_record_t;
+
+/* Safe to call before .data/.bss are initialised */
+void boot_start(void);
+void boot_mark(boot_phase_t phase);
+
+const boot_record_t *boot_record_get(void);
+
+/* Host command handler, see proto.h */
+uint8_t boot_cmd_get_times(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+#endif /* __BOOT_H */
@@ -0,0 +1,45 @@
+/**
+  ******************************************************************************
+  * @file    delay.h
+  * @brief   Busy-wait delays on the DWT cycle counter.
+  *
+  *          Durations are converted with the live SystemCoreClock, so call
+  *          delay_init() again after every clock change.
+  ******************************************************************************
+  */
+
+#ifndef __DELAY_H
+#define __DELAY_H
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+extern uint32_t delay_cycles_per_us;
+
+void delay_init(void);
+void delay_us(uint32_t us);
+
+static inline uint32_t delay_now(void)
+{
+  return DWT->CYCCNT;
+}
+
+/* Core cycles for a duration in ns, rounded up */
+static inline uint32_t delay_ns_to_cycles(uint32_t ns)
+{
+  return (ns * delay_cycles_per_us + 999U) / 1000U;
+}
+
+#if defined(HOST_BUILD)
+/* Advances simulated time instead of spinning */
+void delay_until(uint32_t deadline);
+#else
+static inline void delay_until(uint32_t deadline)
+{
+  while ((int32_t)(DWT->CYCCNT - deadline) < 0)
+  {
+  }
+}
+#endif /* HOST_BUILD */
+
+#endif /* __DELAY_H */
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file    gpio.h
+  * @brief   Pin accessors used by the wire-level drivers.
+  *
+  *          On the target they are plain BSRR/BRR/IDR accesses. The host
+  *          build (HOST_BUILD) additionally lets the peripheral models see
+  *          every write and supply every read.
+  ******************************************************************************
+  */
+
+#ifndef __GPIO_H
+#define __GPIO_H
+
+#include "stm32f1xx.h"
+
+#if defined(HOST_BUILD)
+void host_gpio_write(GPIO_TypeDef *port);
+void host_gpio_read(GPIO_TypeDef *port);
+#define GPIO_HOST_WRITE(port)   host_gpio_write(port)
+#define GPIO_HOST_READ(port)    host_gpio_read(port)
+#else
+#define GPIO_HOST_WRITE(port)   ((void)0)
+#define GPIO_HOST_READ(port)    ((void)0)
+#endif /* HOST_BUILD */
+
+/* Sets the pins in the low half-word and clears those in the high one */
+static inline void gpio_bsrr(GPIO_TypeDef *port, uint32_t bsrr)
+{
+  port->BSRR = bsrr;
+  GPIO_HOST_WRITE(port);
+}
+
+static inline void gpio_set(GPIO_TypeDef *port, uint32_t pins)
+{
+  port->BSRR = pins;
+  GPIO_HOST_WRITE(port);
+}
+
+static inline void gpio_clear(GPIO_TypeDef *port, uint32_t pins)
+{
+  port->BRR = pins;
+  GPIO_HOST_WRITE(port);
+}
+
+static inline uint32_t gpio_read(GPIO_TypeDef *port, uint32_t pins)
+{
+  GPIO_HOST_READ(port);
+  return port->IDR & pins;
+}
+
+#endif /* __GPIO_H */
@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file    hvsp.h
+  * @brief   ATtiny High-voltage Serial Programming: wire engine and the
+  *          datasheet instruction sequences.
+  *
+  *          Every instruction is one or more 11-bit frames: a 0 start bit,
+  *          eight data bits MSB first and two 0 stop bits on SDI (data) and
+  *          SII (instruction) at once, clocked on the rising edge of SCI.
+  *          The target shifts its answer out on SDO during the same frame.
+  *          Operations that program memory leave the target busy (SDO low);
+  *          the caller decides when to hvsp_wait_ready().
+  ******************************************************************************
+  */
+
+#ifndef __HVSP_H
+#define __HVSP_H
+
+#include <stdint.h>
+
+/* Datasheet minima for SCI high/low time; the engine runs at this rate
+   unless HVSP_SCI_HALF_NS is overridden */
+#if !defined(HVSP_SCI_HALF_NS)
+#define HVSP_SCI_HALF_NS          250U
+#endif
+
+/* Programming mode entry, datasheet "High-voltage Serial Programming
+   Algorithm" */
+#define HVSP_VCC_TO_12V_US        40U     /* 20..60 us after VCC */
+#define HVSP_PROG_ENABLE_HOLD_US  10U     /* keep SDI/SII/SDO low after 12 V */
+#define HVSP_ENTRY_WAIT_US        300U    /* before the first instruction */
+
+/* Fuse bytes, as numbered by STK500v2 */
+typedef enum
+{
+  HVSP_FUSE_LOW = 0,
+  HVSP_FUSE_HIGH,
+  HVSP_FUSE_EXT
+} hvsp_fuse_t;
+
+void hvsp_init(void);
+void hvsp_enter(uint32_t power_off_ms);
+void hvsp_leave(void);
+uint8_t hvsp_frame(uint8_t sdi, uint8_t sii);
+int hvsp_ready(void);
+int hvsp_wait_ready(uint32_t timeout_us);
+void hvsp_resync(void);
+
+void hvsp_chip_erase(void);
+void hvsp_flash_load_word(uint16_t addr, uint16_t word);
+void hvsp_flash_program_page(uint16_t addr);
+uint16_t hvsp_flash_read_word(uint16_t addr);
+void hvsp_eeprom_load_byte(uint16_t addr, uint8_t data);
+void hvsp_eeprom_program_page(void);
+uint8_t hvsp_eeprom_read_byte(uint16_t addr);
+void hvsp_fuse_write(hvsp_fuse_t fuse, uint8_t value);
+uint8_t hvsp_fuse_read(hvsp_fuse_t fuse);
+void hvsp_lock_write(uint8_t value);
+uint8_t hvsp_lock_read(void);
+uint8_t hvsp_signature_read(uint8_t addr);
+uint8_t hvsp_calibration_read(void);
+
+#endif /* __HVSP_H */
@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file    irq.h
+  * @brief   Interrupt priorities and the PendSV bottom half.
+  *
+  *          All four priority bits preempt, there are no subpriorities.
+  *          An HVSP frame shift runs above everything: thread mode raises
+  *          BASEPRI for the length of a frame (irq_wire_begin()), so no
+  *          interrupt stretches its SCI grid. Below it the microsecond time
+  *          base and its one-shots, then the link interrupts, which only
+  *          move DMA positions into the receive ring and pend the bottom
+  *          half, and frame parsing with its checksum runs there, in PendSV
+  *          below every device interrupt. Thread mode is left with command
+  *          execution and the rest of the HVSP sequences.
+  ******************************************************************************
+  */
+
+#ifndef __IRQ_H
+#define __IRQ_H
+
+#include "stm32f1xx.h"
+
+/* NVIC_SetPriorityGrouping() value for 4 preemption bits, 0 subpriority */
+#define IRQ_GROUPING            3U
+
+/* Preemption levels, 0 is the most urgent */
+#define IRQ_PRIO_WIRE           0U    /* HVSP frame shift, under irq_wire_begin() */
+#define IRQ_PRIO_TIMER          1U    /* TIM2, TIM3: time base, one-shots */
+#define IRQ_PRIO_LINK           4U    /* USART1, DMA1 channel 5: must stay equal,
+                                         see usart_rx_publish() */
+#define IRQ_PRIO_DEFERRED       15U   /* PendSV */
+
+#if defined(HOST_BUILD)
+/* The CMSIS NVIC functions are bound to the real core addresses */
+static inline void irq_init(void)
+{
+}
+
+/* Runs the bottom half at once, see host/sim.c */
+void irq_defer(void);
+#else
+static inline void irq_init(void)
+{
+  NVIC_SetPriorityGrouping(IRQ_GROUPING);
+  NVIC_SetPriority(PendSV_IRQn, IRQ_PRIO_DEFERRED);
+}
+
+/* Requests the bottom half; it runs once no interrupt is active */
+static inline void irq_defer(void)
+{
+  SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+#endif /* HOST_BUILD */
+
+/* Masks every interrupt below IRQ_PRIO_WIRE for an HVSP frame, about
+   22 SCI half periods; returns the level to restore */
+static inline uint32_t irq_wire_begin(void)
+{
+  uint32_t basepri = __get_BASEPRI();
+
+  __set_BASEPRI(IRQ_PRIO_TIMER << (8U - __NVIC_PRIO_BITS));
+  return basepri;
+}
+
+static inline void irq_wire_end(uint32_t basepri)
+{
+  __set_BASEPRI(basepri);
+}
+
+void PendSV_Handler(void);
+
+#endif /* __IRQ_H */
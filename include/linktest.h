@@ -0,0 +1,35 @@
+/**
+  ******************************************************************************
+  * @file    linktest.h
+  * @brief   Host link self-test: sink, source and echo modes that measure
+  *          the transport without the programming logic.
+  ******************************************************************************
+  */
+
+#ifndef __LINKTEST_H
+#define __LINKTEST_H
+
+#include <stdint.h>
+#include "proto.h"
+
+typedef enum
+{
+  LINKTEST_OFF = 0,
+  LINKTEST_SINK,            /*!< discard received bytes                    */
+  LINKTEST_SOURCE,          /*!< send a generated stream, byte n = n & 0xFF */
+  LINKTEST_ECHO,            /*!< send received bytes back                  */
+  LINKTEST_MODES
+} linktest_mode_t;
+
+/* Largest chunk the source mode hands to the transport at once */
+#define LINKTEST_CHUNK    64U
+
+void linktest_init(proto_write_t write);
+linktest_mode_t linktest_mode(void);
+uint16_t linktest_run(const uint8_t *buf, uint16_t len);
+
+/* Host command handlers, see proto.h */
+uint8_t linktest_cmd_start(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t linktest_cmd_stats(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+#endif /* __LINKTEST_H */
@@ -0,0 +1,15 @@
+/**
+  ******************************************************************************
+  * @file    loop.h
+  * @brief   Run loop: the host link, page pipeline and link event tasks.
+  ******************************************************************************
+  */
+
+#ifndef __LOOP_H
+#define __LOOP_H
+
+void loop_init(void);
+int loop_poll(void);
+int loop_pending(void);
+
+#endif /* __LOOP_H */
@@ -0,0 +1,32 @@
+/**
+  ******************************************************************************
+  * @file    mem.h
+  * @brief   memcpy/memmove/memset/memcmp for the firmware, which links no
+  *          libc (see src/mem.c).
+  *
+  *          The calls map to the compiler builtins, so copies and fills of
+  *          a small constant size expand inline and the rest call the
+  *          functions below. The host build uses its libc.
+  ******************************************************************************
+  */
+
+#ifndef __MEM_H
+#define __MEM_H
+
+#if defined(HOST_BUILD)
+#include <string.h>
+#else
+#include <stddef.h>
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+void *memset(void *dst, int c, size_t n);
+int memcmp(const void *a, const void *b, size_t n);
+
+#define memcpy(dst, src, n)     __builtin_memcpy((dst), (src), (n))
+#define memmove(dst, src, n)    __builtin_memmove((dst), (src), (n))
+#define memset(dst, c, n)       __builtin_memset((dst), (c), (n))
+#define memcmp(a, b, n)         __builtin_memcmp((a), (b), (n))
+#endif /* HOST_BUILD */
+
+#endif /* __MEM_H */
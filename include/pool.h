@@ -0,0 +1,28 @@
+/**
+  ******************************************************************************
+  * @file    pool.h
+  * @brief   Fixed pool of reference-counted frame buffers shared by the
+  *          parser, the command handlers, the page pipeline and the
+  *          transport.
+  ******************************************************************************
+  */
+
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <stdint.h>
+
+/* One whole STK500v2 frame: 5 header bytes, PROTO_BODY_MAX body bytes and
+   the checksum, rounded up to a word */
+#define POOL_BUF_SIZE     284U
+
+/* Frame being parsed, answer being built, answer still on the wire and
+   the request frames of a flash page held for its read-back
+   (PROG_PAGE_SEGS) */
+#define POOL_COUNT        5U
+
+uint8_t *pool_get(void);
+int pool_ref(const void *p);
+void pool_put(const void *p);
+
+#endif /* __POOL_H */
@@ -0,0 +1,73 @@
+/**
+  ******************************************************************************
+  * @file    prof.h
+  * @brief   Per-phase cycle profiler on the DWT cycle counter.
+  *
+  *          prof_begin()/prof_end() bracket a section of code and fold its
+  *          cycle count into a fixed counter. Pairs of the same counter must
+  *          not nest or overlap. Built only with PROF_ENABLE (make PROFILE=1),
+  *          otherwise the markers compile to nothing.
+  ******************************************************************************
+  */
+
+#ifndef __PROF_H
+#define __PROF_H
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+typedef enum
+{
+  PROF_FRAME_SHIFT = 0,     /*!< one HVSP instruction frame on the wire   */
+  PROF_PAGE_LOAD,           /*!< loading a page into the target buffer    */
+  PROF_PAGE_WRITE_WAIT,     /*!< waiting for the target to commit a page  */
+  PROF_HOST_RX_PARSE,       /*!< framing received host bytes              */
+  PROF_DECOMPRESS,          /*!< decompressing an image chunk             */
+  PROF_CRC,                 /*!< CRC over an image chunk                  */
+  PROF_LINK_TX,             /*!< handing an answer to the host transport  */
+  PROF_CMD_EXEC,            /*!< running a host command handler           */
+  PROF_RETRY,               /*!< recovering from a target error           */
+  PROF_PIPE_WAIT,           /*!< command held until the page write is done */
+  PROF_IDLE,                /*!< core asleep, nothing to do               */
+  PROF_COUNT
+} prof_id_t;
+
+typedef struct
+{
+  uint32_t start;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+} prof_counter_t;
+
+#if defined(PROF_ENABLE)
+
+extern prof_counter_t prof_counters[PROF_COUNT];
+
+void prof_record(prof_id_t id, uint32_t cycles);
+
+static inline void prof_begin(prof_id_t id)
+{
+  prof_counters[id].start = DWT->CYCCNT;
+}
+
+static inline void prof_end(prof_id_t id)
+{
+  prof_record(id, DWT->CYCCNT - prof_counters[id].start);
+}
+
+#else
+
+static inline void prof_begin(prof_id_t id) { (void)id; }
+static inline void prof_end(prof_id_t id) { (void)id; }
+
+#endif /* PROF_ENABLE */
+
+void prof_reset(void);
+
+/* Host command handlers, see proto.h */
+uint8_t prof_cmd_get(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prof_cmd_reset(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+#endif /* __PROF_H */
@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file    prog.h
+  * @brief   STK500v2 HVSP programming commands and the flash page pipeline.
+  *
+  *          A page commit is issued to the target and answered at once; the
+  *          busy wait is deferred to the start of the next target access, so
+  *          the host is already sending the next page while the target
+  *          writes the current one.
+  ******************************************************************************
+  */
+
+#ifndef __PROG_H
+#define __PROG_H
+
+#include <stdint.h>
+#include "pt.h"
+
+/* Page pipeline states, reported in TRACE_PAGE_STATE events */
+typedef enum
+{
+  PAGE_IDLE = 0,            /*!< nothing in flight                         */
+  PAGE_LOADING,             /*!< filling the target page buffer            */
+  PAGE_WRITING              /*!< page committed, target busy               */
+} prog_page_state_t;
+
+/* Target power, reported in TRACE_TARGET events */
+typedef enum
+{
+  PROG_TARGET_OFF = 0,      /*!< unpowered                                 */
+  PROG_TARGET_ON,           /*!< in programming mode, session open         */
+  PROG_TARGET_PARKED        /*!< still in programming mode after a leave   */
+} prog_target_t;
+
+/* Busy-wait limit when the host gives no poll timeout */
+#define PROG_DEFAULT_TIMEOUT_MS   100U
+
+/* PARAM_HVSP_KEEPALIVE at reset, in 100 ms units */
+#define PROG_KEEPALIVE_DEFAULT    20U
+
+/* Power-off time before an entry started by the link opening, in place of
+   the host's powoffDelay */
+#define PROG_LINK_POWER_OFF_MS    10U
+
+/* Request frames a flash page may arrive in and still be verified; each
+   holds a pool buffer until the page is written (pool.h) */
+#define PROG_PAGE_SEGS            2U
+
+/* Operations reported in TRACE_RETRY events */
+typedef enum
+{
+  PROG_RETRY_BUSY = 0,      /*!< target still busy after the poll timeout  */
+  PROG_RETRY_READ,          /*!< two reads of the same location differ     */
+  PROG_RETRY_PAGE           /*!< flash page read back wrong, rewritten     */
+} prog_retry_t;
+
+void prog_init(void);
+int prog_busy(void);
+int prog_pending(void);
+PT_THREAD(prog_task(pt_t *pt));
+void prog_set_retries(uint8_t retries);
+uint8_t prog_get_retries(void);
+void prog_set_keepalive(uint8_t keepalive);
+uint8_t prog_get_keepalive(void);
+void prog_link_opened(void);
+
+/* Host command handlers, see proto.h */
+uint8_t prog_cmd_load_address(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_enter(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_leave(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_chip_erase(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_program_flash(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_read_flash(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_program_eeprom(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_read_eeprom(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_program_fuse(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_read_fuse(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_program_lock(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_read_lock(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_read_signature(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t prog_cmd_read_osccal(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+#endif /* __PROG_H */
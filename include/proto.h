@@ -0,0 +1,57 @@
+/**
+  ******************************************************************************
+  * @file    proto.h
+  * @brief   Host protocol: STK500v2 message framing and command dispatch.
+  ******************************************************************************
+  */
+
+#ifndef __PROTO_H
+#define __PROTO_H
+
+#include <stdint.h>
+#include "stk500v2.h"
+
+/* Largest message body accepted or sent: command, status/header and one
+   256-byte page with its length and mode fields */
+#define PROTO_BODY_MAX    275U
+/* Room a handler has for answer data after the command id and status */
+#define PROTO_DATA_MAX    (PROTO_BODY_MAX - 2U)
+
+/**
+  * @brief Command handler. req points at the message body (req[0] is the
+  *        command id), data at the space following the echoed id and status
+  *        byte of the answer. The handler sets *data_len and returns the
+  *        status byte.
+  */
+typedef uint8_t (*proto_handler_t)(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+/* Transport send function, called once per complete answer frame. The
+   transport may still be reading buf when it returns, until the next call
+   returns, so callers alternate between two buffers */
+typedef void (*proto_write_t)(const uint8_t *buf, uint16_t len);
+
+void proto_init(proto_write_t write);
+int proto_rx_ready(void);
+int proto_rx(uint8_t byte);
+void proto_rx_abort(void);
+uint8_t proto_rx_cmd(void);
+void proto_process(void);
+void proto_discard(void);
+
+static inline uint8_t *proto_put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+static inline uint8_t *proto_put_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+  return p + 4;
+}
+
+#endif /* __PROTO_H */
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file    pt.h
+  * @brief   Stackless coroutines (protothreads): a task is a function that
+  *          returns where it blocks and resumes there on the next call,
+  *          keeping only its resume point. Locals do not survive a block;
+  *          keep state in statics.
+  *
+  *          The resume point is a case label, so the blocking macros must
+  *          not be used inside a switch statement of the task body.
+  ******************************************************************************
+  */
+
+#ifndef __PT_H
+#define __PT_H
+
+#include <stdint.h>
+
+typedef struct
+{
+  uint16_t lc;              /*!< resume point: source line, 0 at the start */
+} pt_t;
+
+/* Task return values */
+#define PT_WAITING        0 /*!< blocked until an interrupt delivers data  */
+#define PT_YIELDED        1 /*!< wants to run again without an interrupt   */
+#define PT_ENDED          2
+
+#define PT_THREAD(decl)   int decl
+
+#define PT_INIT(pt)       ((pt)->lc = 0U)
+
+#define PT_BEGIN(pt)      switch ((pt)->lc) { case 0:
+
+#define PT_END(pt)        } (pt)->lc = 0U; return PT_ENDED
+
+/* Block until cond holds, letting the core sleep: cond may only become true
+   through an interrupt or through a task that runs later in the same pass */
+#define PT_WAIT_UNTIL(pt, cond)                                                \
+  do                                                                           \
+  {                                                                            \
+    (pt)->lc = __LINE__;                                                       \
+    __attribute__((fallthrough));                                              \
+    case __LINE__:                                                             \
+    if (!(cond))                                                               \
+    {                                                                          \
+      return PT_WAITING;                                                       \
+    }                                                                          \
+  } while (0)
+
+/* Block until cond holds, keeping the core awake: for conditions polled
+   from hardware, e.g. the target's ready line */
+#define PT_POLL_UNTIL(pt, cond)                                                \
+  do                                                                           \
+  {                                                                            \
+    (pt)->lc = __LINE__;                                                       \
+    __attribute__((fallthrough));                                              \
+    case __LINE__:                                                             \
+    if (!(cond))                                                               \
+    {                                                                          \
+      return PT_YIELDED;                                                       \
+    }                                                                          \
+  } while (0)
+
+/* Give the other tasks one turn */
+#define PT_YIELD(pt)                                                           \
+  do                                                                           \
+  {                                                                            \
+    (pt)->lc = __LINE__;                                                       \
+    return PT_YIELDED;                                                         \
+    case __LINE__:;                                                            \
+  } while (0)
+
+#endif /* __PT_H */
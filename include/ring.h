@@ -0,0 +1,134 @@
+/**
+  ******************************************************************************
+  * @file    ring.h
+  * @brief   Single-producer/single-consumer rings for handing data from an
+  *          interrupt handler (or DMA) to the main loop without masking
+  *          interrupts.
+  *
+  *          head is written by the producer only, tail by the consumer
+  *          only; both are free-running and wrap at 2^16, so the size must
+  *          be a power of two no larger than 32768. A 16-bit store is
+  *          atomic on the Cortex-M3, and the DMBs order the slot accesses
+  *          against the index that publishes or releases them, which also
+  *          covers a DMA producer.
+  ******************************************************************************
+  */
+
+#ifndef __RING_H
+#define __RING_H
+
+#include <stdint.h>
+#include "stm32f1xx.h"
+
+/* Byte ring */
+typedef struct
+{
+  uint8_t *buf;
+  uint16_t mask;            /*!< size - 1                                  */
+  volatile uint16_t head;   /*!< producer: slots published                 */
+  volatile uint16_t tail;   /*!< consumer: slots released                  */
+} ring_t;
+
+/* Message ring: fixed 32-bit records, e.g. an event and its argument */
+typedef struct
+{
+  uint32_t *buf;
+  uint16_t mask;
+  volatile uint16_t head;
+  volatile uint16_t tail;
+} ring_msg_t;
+
+/* Static initialiser over an array whose size is a power of two */
+#define RING_INIT(storage)  { (storage), (uint16_t)(sizeof(storage) / sizeof((storage)[0]) - 1U), 0U, 0U }
+
+static inline uint16_t ring_count(const ring_t *r)
+{
+  return (uint16_t)(r->head - r->tail);
+}
+
+/**
+  * @brief  Producer: appends one byte.
+  * @retval 0, or -1 when the ring is full and the byte was dropped
+  */
+static inline int ring_put(ring_t *r, uint8_t byte)
+{
+  uint16_t head = r->head;
+
+  if ((uint16_t)(head - r->tail) > r->mask)
+  {
+    return -1;
+  }
+  r->buf[head & r->mask] = byte;
+  __DMB();
+  r->head = (uint16_t)(head + 1U);
+  return 0;
+}
+
+/**
+  * @brief  Producer that writes the slots itself, e.g. a circular DMA:
+  *         publishes everything up to head.
+  */
+static inline void ring_publish(ring_t *r, uint16_t head)
+{
+  __DMB();
+  r->head = head;
+}
+
+/**
+  * @brief  Consumer: takes one byte.
+  * @retval The byte, or -1 when the ring is empty
+  */
+static inline int ring_get(ring_t *r)
+{
+  uint16_t tail = r->tail;
+  uint8_t byte;
+
+  if (tail == r->head)
+  {
+    return -1;
+  }
+  __DMB();
+  byte = r->buf[tail & r->mask];
+  __DMB();
+  r->tail = (uint16_t)(tail + 1U);
+  return byte;
+}
+
+/**
+  * @brief  Producer: appends one message.
+  * @retval 0, or -1 when the ring is full and the message was dropped
+  */
+static inline int ring_msg_put(ring_msg_t *r, uint32_t msg)
+{
+  uint16_t head = r->head;
+
+  if ((uint16_t)(head - r->tail) > r->mask)
+  {
+    return -1;
+  }
+  r->buf[head & r->mask] = msg;
+  __DMB();
+  r->head = (uint16_t)(head + 1U);
+  return 0;
+}
+
+/**
+  * @brief  Consumer: takes one message.
+  * @retval 1 with *msg set, 0 when the ring is empty
+  */
+static inline int ring_msg_get(ring_msg_t *r, uint32_t *msg)
+{
+  uint16_t tail = r->tail;
+
+  if (tail == r->head)
+  {
+    return 0;
+  }
+  __DMB();
+  *msg = r->buf[tail & r->mask];
+  __DMB();
+  r->tail = (uint16_t)(tail + 1U);
+  return 1;
+}
+
+#endif /* __RING_H */
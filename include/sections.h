@@ -0,0 +1,28 @@
+/**
+  ******************************************************************************
+  * @file    sections.h
+  * @brief   Placement attributes for the RAM sections defined in
+  *          STM32F103X6_FLASH.ld.
+  ******************************************************************************
+  */
+
+#ifndef __SECTIONS_H
+#define __SECTIONS_H
+
+#include <stdint.h>
+
+/**
+  * @brief Places a variable in .noinit. Reset_Handler neither copies nor
+  *        zeroes this region, so the contents survive a warm reset and are
+  *        garbage after power-up; guard them with a magic value.
+  */
+#define __NOINIT  __attribute__((section(".noinit")))
+
+/* Region bounds, defined in the linker script */
+extern uint32_t _snoinit;
+extern uint32_t _enoinit;
+extern uint32_t _sarena;
+extern uint32_t _earena;
+extern uint32_t _estack;
+
+#endif /* __SECTIONS_H */
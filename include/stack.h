@@ -0,0 +1,25 @@
+/**
+  ******************************************************************************
+  * @file    stack.h
+  * @brief   Stack high-water measurement.
+  *
+  *          Reset_Handler paints the stack reservation (_earena.._estack)
+  *          with STACK_PAINT before main(); the deepest word that no longer
+  *          holds the pattern is the most stack ever used. Read with
+  *          CMD_STACK_STATS.
+  ******************************************************************************
+  */
+
+#ifndef __STACK_H
+#define __STACK_H
+
+#include <stdint.h>
+
+/* Fill pattern, must match the constant in startup_stm32f103x6.s */
+#define STACK_PAINT       0xC5C5C5C5UL
+
+uint32_t stack_size(void);
+uint32_t stack_high_water(void);
+uint8_t stack_cmd_stats(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+#endif /* __STACK_H */
@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file    stk500v2.h
+  * @brief   STK500 protocol version 2 constants (Atmel AVR068), limited to
+  *          the subset the programmer implements, plus the vendor commands
+  *          used for diagnostics.
+  ******************************************************************************
+  */
+
+#ifndef __STK500V2_H
+#define __STK500V2_H
+
+/* Framing */
+#define MESSAGE_START                 0x1BU
+#define TOKEN                         0x0EU
+
+/* General commands */
+#define CMD_SIGN_ON                   0x01U
+#define CMD_SET_PARAMETER             0x02U
+#define CMD_GET_PARAMETER             0x03U
+#define CMD_LOAD_ADDRESS              0x06U
+
+/* High-voltage serial programming commands */
+#define CMD_ENTER_PROGMODE_HVSP       0x30U
+#define CMD_LEAVE_PROGMODE_HVSP       0x31U
+#define CMD_CHIP_ERASE_HVSP           0x32U
+#define CMD_PROGRAM_FLASH_HVSP        0x33U
+#define CMD_READ_FLASH_HVSP           0x34U
+#define CMD_PROGRAM_EEPROM_HVSP       0x35U
+#define CMD_READ_EEPROM_HVSP          0x36U
+#define CMD_PROGRAM_FUSE_HVSP         0x37U
+#define CMD_READ_FUSE_HVSP            0x38U
+#define CMD_PROGRAM_LOCK_HVSP         0x39U
+#define CMD_READ_LOCK_HVSP            0x3AU
+#define CMD_READ_SIGNATURE_HVSP       0x3BU
+#define CMD_READ_OSCCAL_HVSP          0x3CU
+
+/* Vendor diagnostics commands, outside the AVR068 command space */
+#define CMD_GET_BOOT_TIMES            0x80U
+#define CMD_GET_PROFILE               0x81U
+#define CMD_RESET_PROFILE             0x82U
+#define CMD_TRACE_DUMP                0x83U
+#define CMD_TRACE_CLEAR               0x84U
+#define CMD_LINK_TEST                 0x85U
+#define CMD_LINK_STATS                0x86U
+#define CMD_SET_BAUD                  0x87U
+#define CMD_ARENA_STATS               0x88U
+#define CMD_STACK_STATS               0x89U
+
+/* Status codes */
+#define STATUS_CMD_OK                 0x00U
+#define STATUS_CMD_TOUT               0x80U
+#define STATUS_RDY_BSY_TOUT           0x81U
+#define STATUS_SET_PARAM_MISSING      0x82U
+#define STATUS_CMD_FAILED             0xC0U
+#define STATUS_CKSUM_ERROR            0xC1U
+#define STATUS_CMD_UNKNOWN            0xC9U
+
+/* Answer to a frame with a bad checksum */
+#define ANSWER_CKSUM_ERROR            0xB0U
+
+/* Parameters */
+#define PARAM_BUILD_NUMBER_LOW        0x80U
+#define PARAM_BUILD_NUMBER_HIGH       0x81U
+#define PARAM_HW_VER                  0x90U
+#define PARAM_SW_MAJOR                0x91U
+#define PARAM_SW_MINOR                0x92U
+#define PARAM_VTARGET                 0x94U
+#define PARAM_VADJUST                 0x95U
+#define PARAM_OSC_PSCALE              0x96U
+#define PARAM_OSC_CMATCH              0x97U
+#define PARAM_SCK_DURATION            0x98U
+#define PARAM_TOPCARD_DETECT          0x9AU
+#define PARAM_STATUS                  0x9CU
+#define PARAM_DATA                    0x9DU
+#define PARAM_RESET_POLARITY          0x9EU
+#define PARAM_CONTROLLER_INIT         0x9FU
+
+/* Vendor parameters */
+#define PARAM_HVSP_RETRIES            0xA0U   /* error recovery, see prog.c */
+#define PARAM_HVSP_KEEPALIVE          0xA1U   /* 100 ms units, see prog.c */
+
+#endif /* __STK500V2_H */
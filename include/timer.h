@@ -0,0 +1,30 @@
+/**
+  ******************************************************************************
+  * @file    timer.h
+  * @brief   Microsecond time base on TIM2/TIM3: a 64-bit monotonic clock
+  *          and one-shot callbacks.
+  ******************************************************************************
+  */
+
+#ifndef __TIMER_H
+#define __TIMER_H
+
+#include <stdint.h>
+
+/* One-shot callbacks that can be pending at once */
+#define TIMER_SLOTS       4U
+
+/* Called from the TIM2 interrupt */
+typedef void (*timer_cb_t)(void *arg);
+
+void timer_init(void);
+void timer_clock_changed(void);
+uint64_t timer_now_us(void);
+int timer_oneshot(uint32_t delay_us, timer_cb_t cb, void *arg);
+void timer_cancel(int slot);
+
+/* Hardware layer, host/sim.c in the host build */
+void timer_hw_kick(void);
+void TIM2_IRQHandler(void);
+
+#endif /* __TIMER_H */
@@ -0,0 +1,66 @@
+/**
+  ******************************************************************************
+  * @file    trace.h
+  * @brief   Timestamped binary event trace in a .noinit ring buffer.
+  *
+  *          trace_event() may be called from any context, including nested
+  *          interrupts: slots are claimed with LDREX/STREX and nothing masks
+  *          interrupts. The ring survives a warm reset, so the events leading
+  *          up to a crash can still be dumped with CMD_TRACE_DUMP. Built only
+  *          with TRACE_ENABLE (make TRACE=1).
+  ******************************************************************************
+  */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdint.h>
+
+/* Ring capacity in records, must be a power of two */
+#define TRACE_SIZE        128U
+
+typedef enum
+{
+  TRACE_ISR_ENTER = 1,      /*!< arg: IRQn + 16 (exception number)          */
+  TRACE_ISR_EXIT,           /*!< arg: IRQn + 16                             */
+  TRACE_CMD_START,          /*!< arg: command id, data: body length         */
+  TRACE_CMD_END,            /*!< arg: command id, data: status              */
+  TRACE_PAGE_STATE,         /*!< arg: new page state, data: page number     */
+  TRACE_RETRY,              /*!< arg: operation, data: attempt              */
+  TRACE_MARK,               /*!< free-form marker                           */
+  TRACE_BAUD,               /*!< arg: 1 after autobaud, data: USART BRR     */
+  TRACE_TARGET,             /*!< arg: prog_target_t, data: 1 when resumed   */
+  TRACE_BOOT                /*!< arg: 1 after a warm reset; CYCCNT restarts */
+} trace_event_t;
+
+/* 8-byte record */
+typedef struct
+{
+  uint32_t cycles;          /*!< DWT CYCCNT when the event was logged */
+  uint8_t event;
+  uint8_t arg;
+  uint16_t data;
+} trace_rec_t;
+
+#if defined(TRACE_ENABLE)
+
+void trace_init(void);
+void trace_event(trace_event_t event, uint8_t arg, uint16_t data);
+
+#else
+
+static inline void trace_init(void) { }
+static inline void trace_event(trace_event_t event, uint8_t arg, uint16_t data)
+{
+  (void)event;
+  (void)arg;
+  (void)data;
+}
+
+#endif /* TRACE_ENABLE */
+
+/* Host command handlers, see proto.h */
+uint8_t trace_cmd_dump(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+uint8_t trace_cmd_clear(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+#endif /* __TRACE_H */
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * @file    usart.h
+  * @brief   USART1 host link (PA9 TX, PA10 RX) on DMA1: circular receive on
+  *          channel 5, transmit on channel 4. DTR# (PA8) edges are reported
+  *          as link events.
+  ******************************************************************************
+  */
+
+#ifndef __USART_H
+#define __USART_H
+
+#include <stdint.h>
+
+/* STK500v2 default line rate */
+#define USART_BAUDRATE    115200U
+
+/* Give-up time for the autobaud sync byte */
+#define USART_AUTOBAUD_TIMEOUT_MS   2000U
+
+/* Link events, from usart_link_event() */
+#define USART_LINK_OPEN   1U        /* host asserted DTR, i.e. opened the port */
+#define USART_LINK_CLOSE  2U
+
+void usart_init(uint32_t baudrate);
+int usart_getc(void);
+uint32_t usart_rx_laps(void);
+int usart_rx_pending(void);
+void usart_write(const uint8_t *buf, uint16_t len);
+void usart_commit(void);
+int usart_autobaud_poll(void);
+int usart_link_event(uint32_t *event);
+int usart_link_pending(void);
+
+/* Host command handler, see proto.h */
+uint8_t usart_cmd_set_baud(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+#endif /* __USART_H */
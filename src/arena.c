@@ -0,0 +1,106 @@
+/**
+  ******************************************************************************
+  * @file    arena.c
+  * @brief   Session arena: bump allocation from the RAM left between the
+  *          static data and the stack, released in O(1) at session end.
+  *
+  *          The linker script hands every byte between the end of .noinit
+  *          and the stack reservation to the arena (_sarena.._earena)
+  *          instead of reserving a heap. A session takes a mark when it
+  *          starts, allocates its buffers as it needs them and releases
+  *          back to the mark when it ends; sessions nest like a stack.
+  *          Allocations live until a release and are not freed one by
+  *          one. Thread mode only.
+  ******************************************************************************
+  */
+
+#include "arena.h"
+#include "proto.h"
+#include "sections.h"
+
+#if defined(HOST_BUILD)
+static uint8_t arena_mem[4096] __attribute__((aligned(ARENA_ALIGN)));
+#define ARENA_BASE        ((uintptr_t)arena_mem)
+#define ARENA_END         ((uintptr_t)arena_mem + sizeof(arena_mem))
+#else
+#define ARENA_BASE        ((uintptr_t)&_sarena)
+#define ARENA_END         ((uintptr_t)&_earena)
+#endif /* HOST_BUILD */
+
+static uint32_t arena_top;    /* bytes in use */
+static uint32_t arena_high;   /* most bytes ever in use */
+
+/**
+  * @brief  Empties the arena and clears the high-water mark.
+  * @param  None
+  * @retval None
+  */
+void arena_init(void)
+{
+  arena_top = 0U;
+  arena_high = 0U;
+}
+
+/**
+  * @brief  Carves a block out of the arena, ARENA_ALIGN aligned.
+  * @param  size: bytes wanted
+  * @retval The block, or 0 when the arena cannot hold it
+  */
+void *arena_alloc(uint32_t size)
+{
+  uint32_t top = (arena_top + ARENA_ALIGN - 1U) & ~(ARENA_ALIGN - 1U);
+
+  if (size > ARENA_END - ARENA_BASE - top)
+  {
+    return 0;
+  }
+  arena_top = top + size;
+  if (arena_top > arena_high)
+  {
+    arena_high = arena_top;
+  }
+  return (void *)(ARENA_BASE + top);
+}
+
+/**
+  * @brief  Current level, for a later arena_release().
+  * @param  None
+  * @retval Mark
+  */
+arena_mark_t arena_mark(void)
+{
+  return arena_top;
+}
+
+/**
+  * @brief  Frees everything allocated since the mark was taken. A mark
+  *         above the current level (an inner session already gone with
+  *         an outer one) leaves the arena as it is.
+  * @param  mark: value from arena_mark()
+  * @retval None
+  */
+void arena_release(arena_mark_t mark)
+{
+  if (mark < arena_top)
+  {
+    arena_top = mark;
+  }
+}
+
+/**
+  * @brief  CMD_ARENA_STATS: answers the arena size, the bytes in use and
+  *         the high-water mark, u32 little-endian each.
+  */
+uint8_t arena_cmd_stats(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint8_t *p = data;
+
+  (void)req;
+  (void)len;
+
+  p = proto_put_u32(p, (uint32_t)(ARENA_END - ARENA_BASE));
+  p = proto_put_u32(p, arena_top);
+  p = proto_put_u32(p, arena_high);
+  *data_len = (uint16_t)(p - data);
+  return STATUS_CMD_OK;
+}
@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file    autobaud.c
+  * @brief   Line rate measurement from a 0x55 sync byte on the USART1 RX
+  *          pin (PA10), for CMD_SET_BAUD with rate 0.
+  *
+  *          usart.c arms the start edge interrupt, which samples the pin
+  *          before anything else (autobaud_sample()) and then times the rest
+  *          of the byte by polling. The host build runs the same code
+  *          against a UART line model (programmer -a).
+  ******************************************************************************
+  */
+
+#include "autobaud.h"
+
+/* Give-up time of autobaud_measure(), in core cycles */
+static uint32_t autobaud_limit;
+
+/**
+  * @brief  Prepares a measurement for the current clock: ten bit times at
+  *         BRR 0xFFFF, the slowest rate. Call before unmasking the start
+  *         edge interrupt, so the handler has nothing to compute up front.
+  * @param  None
+  * @retval None
+  */
+void autobaud_arm(void)
+{
+  autobaud_limit = (0xFFFFUL << APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos]) * 10U;
+}
+
+/**
+  * @brief  Times the rest of a 0x55 sync byte with the receiver off, from
+  *         the sample taken on entry. Takes at most one character at the
+  *         slowest rate.
+  * @param  s: autobaud_sample() taken within the start bit
+  * @retval Core cycles for AUTOBAUD_BITS bit times, 0 on timeout
+  */
+uint32_t autobaud_measure(const autobaud_sample_t *s)
+{
+  uint32_t level = s->level;
+  uint32_t first = 0U;
+  uint32_t now = s->start;
+  uint32_t edges = 0U;
+
+  while (edges < AUTOBAUD_EDGES)
+  {
+    uint32_t pin = gpio_read(LINK_RX_PORT, LINK_RX);
+
+    now = delay_now();
+    if (pin != level)
+    {
+      level = pin;
+      if (pin == 0U && edges++ == 0U)
+      {
+        first = now;
+      }
+    }
+    else if (now - s->start > autobaud_limit)
+    {
+      return 0U;
+    }
+  }
+  return now - first;
+}
+
+/**
+  * @brief  USART BRR for a measured sync byte.
+  * @param  cycles: result of autobaud_measure()
+  * @retval BRR, or 0 when the measurement is outside the 16..0xFFFF range
+  */
+uint32_t autobaud_brr(uint32_t cycles)
+{
+  /* BRR counts APB2 clocks per bit, the cycle counter core clocks */
+  uint32_t brr = ((cycles >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos])
+                  + AUTOBAUD_BITS / 2U) / AUTOBAUD_BITS;
+
+  return (brr >= 16U && brr <= 0xFFFFU) ? brr : 0U;
+}
@@ -0,0 +1,249 @@
+/**
+  ******************************************************************************
+  * @file    bench.c
+  * @brief   Firmware micro-benchmarks for the SIM_BENCH build.
+  *
+  *          Each benchmark runs a firmware path a fixed number of times and
+  *          is timed with SysTick on the core clock. Output goes through
+  *          semihosting, one line per benchmark:
+  *
+  *            bench <name> <iterations> <ticks>
+  *
+  *          On the board ticks are core cycles. Under QEMU with
+  *          -icount shift=0 each instruction takes 1 ns of virtual time, so
+  *          ticks / SysTick clock give retired instructions (see
+  *          tools/simbench.py). Only the core, SysTick and RAM are used:
+  *          the emulated machine has no STM32F1 peripherals.
+  ******************************************************************************
+  */
+
+#include "bench.h"
+#include "mem.h"
+#include "proto.h"
+#include "stm32f1xx.h"
+
+/* Semihosting operations */
+#define SEMIHOST_SYS_WRITE0       0x04U
+#define SEMIHOST_SYS_EXIT         0x18U
+#define SEMIHOST_APP_EXIT         0x20026U
+
+#define BENCH_ITERATIONS          200U
+#define BENCH_FLASH_PAGE          256U
+
+typedef struct
+{
+  const char *name;
+  void (*run)(void);
+} bench_t;
+
+static volatile uint32_t bench_wraps;
+static uint8_t bench_rx_frame[BENCH_FLASH_PAGE + 11U];
+static uint16_t bench_rx_len;
+static uint8_t bench_sign_on[7];
+static uint8_t bench_get_param[8];
+static uint32_t bench_tx_bytes;
+static uint32_t bench_page[2][BENCH_FLASH_PAGE / 4U];
+
+static uint32_t bench_semihost(uint32_t op, const void *arg)
+{
+  register uint32_t r0 __asm("r0") = op;
+  register const void *r1 __asm("r1") = arg;
+
+  __asm volatile ("bkpt 0xAB" : "+r" (r0) : "r" (r1) : "memory");
+  return r0;
+}
+
+void SysTick_Handler(void)
+{
+  bench_wraps++;
+}
+
+/**
+  * @brief  SysTick ticks since bench_run() started it.
+  */
+static uint32_t bench_ticks(void)
+{
+  uint32_t wraps;
+  uint32_t val;
+
+  do
+  {
+    wraps = bench_wraps;
+    val = SysTick->VAL;
+  } while (wraps != bench_wraps);
+
+  return (wraps << 24) + (SysTick_LOAD_RELOAD_Msk - val);
+}
+
+static void bench_write(const uint8_t *buf, uint16_t len)
+{
+  (void)buf;
+  bench_tx_bytes += len;
+}
+
+/**
+  * @brief  Wraps a body into an STK500v2 frame.
+  * @retval Frame length
+  */
+static uint16_t bench_frame(uint8_t *frame, const uint8_t *body, uint16_t len)
+{
+  uint8_t checksum = 0U;
+
+  frame[0] = MESSAGE_START;
+  frame[1] = 0U;
+  frame[2] = (uint8_t)(len >> 8);
+  frame[3] = (uint8_t)len;
+  frame[4] = TOKEN;
+  memcpy(&frame[5], body, len);
+  for (uint16_t i = 0U; i < len + 5U; i++)
+  {
+    checksum ^= frame[i];
+  }
+  frame[len + 5U] = checksum;
+  return (uint16_t)(len + 6U);
+}
+
+static void bench_feed(const uint8_t *frame, uint16_t len)
+{
+  for (uint16_t i = 0U; i < len; i++)
+  {
+    (void)proto_rx(frame[i]);
+  }
+}
+
+/* Receive a full-page CMD_PROGRAM_FLASH_HVSP frame: framing and checksum.
+   The frame is released unanswered, the handler is not part of this bench */
+static void bench_rx_page(void)
+{
+  bench_feed(bench_rx_frame, bench_rx_len);
+  proto_discard();
+}
+
+/* Receive, dispatch and answer CMD_SIGN_ON */
+static void bench_cmd_sign_on(void)
+{
+  bench_feed(bench_sign_on, sizeof(bench_sign_on));
+  proto_process();
+}
+
+/* Receive, dispatch and answer CMD_GET_PARAMETER */
+static void bench_cmd_get_param(void)
+{
+  bench_feed(bench_get_param, sizeof(bench_get_param));
+  proto_process();
+}
+
+/* Copy a flash page between word-aligned buffers */
+static void bench_memcpy_page(void)
+{
+  memcpy(bench_page[1], bench_page[0], BENCH_FLASH_PAGE);
+}
+
+/* Copy a flash page with source and destination a byte apart */
+static void bench_memcpy_unaligned(void)
+{
+  memcpy((uint8_t *)bench_page[1] + 1, bench_page[0], BENCH_FLASH_PAGE - 4U);
+}
+
+/* Fill a flash page with the erased value */
+static void bench_memset_page(void)
+{
+  memset(bench_page[1], 0xFF, BENCH_FLASH_PAGE);
+}
+
+static const bench_t bench_list[] =
+{
+  { "rx_page",            bench_rx_page },
+  { "cmd_sign_on",        bench_cmd_sign_on },
+  { "cmd_get_param",      bench_cmd_get_param },
+  { "memcpy_page",        bench_memcpy_page },
+  { "memcpy_unaligned",   bench_memcpy_unaligned },
+  { "memset_page",        bench_memset_page },
+};
+
+static char *bench_put_str(char *p, const char *s)
+{
+  while (*s != '\0')
+  {
+    *p++ = *s++;
+  }
+  return p;
+}
+
+static char *bench_put_u32(char *p, uint32_t v)
+{
+  char tmp[10];
+  uint32_t n = 0U;
+
+  do
+  {
+    tmp[n++] = (char)('0' + v % 10U);
+    v /= 10U;
+  } while (v != 0U);
+
+  while (n != 0U)
+  {
+    *p++ = tmp[--n];
+  }
+  return p;
+}
+
+void bench_run(void)
+{
+  uint8_t body[BENCH_FLASH_PAGE + 5U];
+  char line[64];
+
+  body[0] = CMD_PROGRAM_FLASH_HVSP;
+  body[1] = (uint8_t)(BENCH_FLASH_PAGE >> 8);
+  body[2] = (uint8_t)BENCH_FLASH_PAGE;
+  body[3] = 0xC1U;
+  body[4] = 10U;
+  for (uint32_t i = 0U; i < BENCH_FLASH_PAGE; i++)
+  {
+    body[5U + i] = (uint8_t)(i * 37U);
+  }
+  bench_rx_len = bench_frame(bench_rx_frame, body, sizeof(body));
+
+  body[0] = CMD_SIGN_ON;
+  (void)bench_frame(bench_sign_on, body, 1U);
+  body[0] = CMD_GET_PARAMETER;
+  body[1] = PARAM_SW_MAJOR;
+  (void)bench_frame(bench_get_param, body, 2U);
+
+  proto_init(bench_write);
+
+  SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+  SysTick->VAL = 0U;
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+
+  for (uint32_t b = 0U; b < sizeof(bench_list) / sizeof(bench_list[0]); b++)
+  {
+    uint32_t start;
+    uint32_t ticks;
+    char *p;
+
+    bench_list[b].run();    /* warm-up, leaves the state machines idle */
+
+    start = bench_ticks();
+    for (uint32_t i = 0U; i < BENCH_ITERATIONS; i++)
+    {
+      bench_list[b].run();
+    }
+    ticks = bench_ticks() - start;
+
+    p = bench_put_str(line, "bench ");
+    p = bench_put_str(p, bench_list[b].name);
+    p = bench_put_str(p, " ");
+    p = bench_put_u32(p, BENCH_ITERATIONS);
+    p = bench_put_str(p, " ");
+    p = bench_put_u32(p, ticks);
+    p = bench_put_str(p, "\n");
+    *p = '\0';
+    (void)bench_semihost(SEMIHOST_SYS_WRITE0, line);
+  }
+
+  for (;;)
+  {
+    (void)bench_semihost(SEMIHOST_SYS_EXIT, (const void *)SEMIHOST_APP_EXIT);
+  }
+}
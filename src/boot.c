@@ -0,0 +1,86 @@
+/**
+  ******************************************************************************
+  * @file    boot.c
+  * @brief   Boot-phase timestamps taken from the DWT cycle counter.
+  ******************************************************************************
+  */
+
+#include "boot.h"
+#include "proto.h"
+#include "sections.h"
+#include "stm32f1xx.h"
+
+static boot_record_t boot_record __NOINIT;
+
+/**
+  * @brief  Starts the DWT cycle counter from zero and forgets the previous
+  *         boot. Called as the very first instruction of Reset_Handler, so
+  *         it must not rely on .data or .bss.
+  * @param  None
+  * @retval None
+  */
+void boot_start(void)
+{
+#if !defined(SIM_BENCH)   /* no DWT on the emulated Cortex-M3 */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0U;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+  boot_record.stamped = 0U;
+}
+
+/**
+  * @brief  Records the end of a boot phase. Only the first call per phase
+  *         and boot counts, so callers on hot paths need no guard of their
+  *         own. Must not rely on .data or .bss either.
+  * @param  phase: phase that has just completed
+  * @retval None
+  */
+void boot_mark(boot_phase_t phase)
+{
+#if defined(SIM_BENCH)
+  uint32_t now = 0U;
+#else
+  uint32_t now = DWT->CYCCNT;
+#endif
+  uint32_t bit = 1UL << phase;
+
+  if ((boot_record.stamped & bit) == 0U)
+  {
+    boot_record.cycles[phase] = now;
+    boot_record.stamped |= bit;
+  }
+}
+
+/**
+  * @brief  Returns the boot record of the current boot.
+  * @param  None
+  * @retval Pointer to the record
+  */
+const boot_record_t *boot_record_get(void)
+{
+  return &boot_record;
+}
+
+/**
+  * @brief  CMD_GET_BOOT_TIMES: stamped mask, current HCLK in Hz, then the
+  *         cycle count of every phase, all little-endian 32-bit words.
+  */
+uint8_t boot_cmd_get_times(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint8_t *p = data;
+
+  (void)req;
+  (void)len;
+
+  p = proto_put_u32(p, boot_record.stamped);
+  p = proto_put_u32(p, SystemCoreClock);
+  for (uint32_t i = 0U; i < BOOT_PHASE_COUNT; i++)
+  {
+    p = proto_put_u32(p, boot_record.cycles[i]);
+  }
+
+  *data_len = (uint16_t)(p - data);
+  return STATUS_CMD_OK;
+}
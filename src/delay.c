@@ -0,0 +1,53 @@
+/**
+  ******************************************************************************
+  * @file    delay.c
+  * @brief   Busy-wait delays on the DWT cycle counter.
+  ******************************************************************************
+  */
+
+#include "delay.h"
+
+uint32_t delay_cycles_per_us = 8U;
+
+/* Cycles delay_us() spends outside its wait, measured by delay_init() */
+static uint32_t delay_overhead;
+
+/**
+  * @brief  Refreshes the cycle/us factor from SystemCoreClock and measures
+  *         the call overhead of delay_us() at that clock (flash wait states
+  *         change with it).
+  * @param  None
+  * @retval None
+  */
+void delay_init(void)
+{
+  uint32_t t0;
+  uint32_t t1;
+  uint32_t t2;
+
+  delay_cycles_per_us = SystemCoreClock / 1000000U;
+  delay_overhead = 0U;
+
+  t0 = delay_now();
+  t1 = delay_now();
+  delay_us(0U);
+  t2 = delay_now();
+  /* Remove the cost of reading the counter itself */
+  delay_overhead = (t2 - t1 > t1 - t0) ? (t2 - t1) - (t1 - t0) : 0U;
+}
+
+/**
+  * @brief  Waits at least the given time. Longer than ~59 s at 72 MHz wraps.
+  * @param  us: delay in microseconds
+  * @retval None
+  */
+void delay_us(uint32_t us)
+{
+  uint32_t start = delay_now();
+  uint32_t cycles = us * delay_cycles_per_us;
+
+  if (cycles > delay_overhead)
+  {
+    delay_until(start + cycles - delay_overhead);
+  }
+}
@@ -0,0 +1,362 @@
+/**
+  ******************************************************************************
+  * @file    hvsp.c
+  * @brief   ATtiny High-voltage Serial Programming: wire engine and the
+  *          datasheet instruction sequences.
+  ******************************************************************************
+  */
+
+#include "hvsp.h"
+#include "board.h"
+#include "delay.h"
+#include "gpio.h"
+#include "irq.h"
+#include "prof.h"
+
+/* Command bytes for "Load Command" (SII 0x4C) */
+#define HVSP_CMD_NONE             0x00U
+#define HVSP_CMD_CHIP_ERASE       0x80U
+#define HVSP_CMD_WRITE_FUSE       0x40U
+#define HVSP_CMD_WRITE_LOCK       0x20U
+#define HVSP_CMD_WRITE_FLASH      0x10U
+#define HVSP_CMD_WRITE_EEPROM     0x11U
+#define HVSP_CMD_READ_SIG_CAL     0x08U
+#define HVSP_CMD_READ_FUSE_LOCK   0x04U
+#define HVSP_CMD_READ_EEPROM      0x03U
+#define HVSP_CMD_READ_FLASH       0x02U
+
+/* SCI half period in core cycles */
+static uint32_t hvsp_half;
+
+/* Command currently loaded in the target, so repeated reads and writes of
+   the same memory skip the Load Command frame */
+static uint8_t hvsp_cmd;
+
+/**
+  * @brief  Loads a command unless it is already the current one.
+  * @param  cmd: HVSP_CMD_xxx
+  * @retval None
+  */
+static void hvsp_load_cmd(uint8_t cmd)
+{
+  if (hvsp_cmd != cmd)
+  {
+    hvsp_frame(cmd, 0x4CU);
+    hvsp_cmd = cmd;
+  }
+}
+
+/**
+  * @brief  Configures the HVSP pins with the target unpowered and derives
+  *         the SCI period, so no frame is ever clocked with a zero one.
+  * @param  None
+  * @retval None
+  */
+void hvsp_init(void)
+{
+  RCC->APB2ENR |= RCC_APB2ENR_IOPAEN;
+
+  gpio_clear(HVSP_PORT, HVSP_PINS);
+  HVSP_PORT->CRL = (HVSP_PORT->CRL & ~HVSP_CRL_MASK) | HVSP_CRL_OUT;
+
+  hvsp_half = delay_ns_to_cycles(HVSP_SCI_HALF_NS);
+  hvsp_cmd = HVSP_CMD_NONE;
+}
+
+/**
+  * @brief  Power-cycles the target into High-voltage Serial Programming mode.
+  *         The SCI period is derived here so it follows the current clock.
+  * @param  power_off_ms: time the target is held unpowered first
+  * @retval None
+  */
+void hvsp_enter(uint32_t power_off_ms)
+{
+  /* Prog_enable: SDI, SII and SDO low, RESET at 0 V, VCC off */
+  HVSP_PORT->CRL = (HVSP_PORT->CRL & ~HVSP_CRL_MASK) | HVSP_CRL_OUT;
+  gpio_clear(HVSP_PORT, HVSP_PINS);
+  delay_us(power_off_ms * 1000U);
+
+  gpio_set(HVSP_PORT, HVSP_VCC);
+  delay_us(HVSP_VCC_TO_12V_US);
+  gpio_set(HVSP_PORT, HVSP_12V);
+  delay_us(HVSP_PROG_ENABLE_HOLD_US);
+
+  /* Release SDO before the target starts driving it */
+  HVSP_PORT->CRL = (HVSP_PORT->CRL & ~HVSP_CRL_MASK) | HVSP_CRL_SDO_IN;
+  delay_us(HVSP_ENTRY_WAIT_US);
+
+  hvsp_half = delay_ns_to_cycles(HVSP_SCI_HALF_NS);
+  hvsp_cmd = HVSP_CMD_NONE;
+}
+
+/**
+  * @brief  Leaves programming mode and removes target power.
+  * @param  None
+  * @retval None
+  */
+void hvsp_leave(void)
+{
+  gpio_clear(HVSP_PORT, HVSP_SCI | HVSP_SDI | HVSP_SII);
+  gpio_clear(HVSP_PORT, HVSP_12V);
+  gpio_clear(HVSP_PORT, HVSP_VCC);
+  HVSP_PORT->CRL = (HVSP_PORT->CRL & ~HVSP_CRL_MASK) | HVSP_CRL_OUT;
+}
+
+/**
+  * @brief  Shifts one 11-bit frame. SDI/SII change while SCI is low and are
+  *         sampled by the target on the rising edge; SDO is sampled just
+  *         before the rising edges of the eight data bits. Edges are placed
+  *         on a fixed cycle grid so the waveform does not depend on code
+  *         timing; interrupts are held back meanwhile (irq_wire_begin()),
+  *         as a late edge would leave the following half period short.
+  * @param  sdi: data byte
+  * @param  sii: instruction byte
+  * @retval Byte shifted out by the target on SDO
+  */
+uint8_t hvsp_frame(uint8_t sdi, uint8_t sii)
+{
+  uint32_t sdi_bits = (uint32_t)sdi << 2;   /* start bit and stop bits are 0 */
+  uint32_t sii_bits = (uint32_t)sii << 2;
+  uint32_t edge;
+  uint32_t basepri;
+  uint8_t sdo = 0U;
+
+  prof_begin(PROF_FRAME_SHIFT);
+  basepri = irq_wire_begin();
+  edge = delay_now();
+  for (int32_t bit = 10; bit >= 0; bit--)
+  {
+    uint32_t bsrr = (((sdi_bits >> bit) & 1U) != 0U ? HVSP_SDI : (HVSP_SDI << 16))
+                  | (((sii_bits >> bit) & 1U) != 0U ? HVSP_SII : (HVSP_SII << 16));
+
+    gpio_bsrr(HVSP_PORT, bsrr);
+    if (bit <= 9 && bit >= 2)
+    {
+      sdo = (uint8_t)((sdo << 1) | (gpio_read(HVSP_PORT, HVSP_SDO) != 0U ? 1U : 0U));
+    }
+
+    edge += hvsp_half;
+    delay_until(edge);
+    gpio_set(HVSP_PORT, HVSP_SCI);
+    edge += hvsp_half;
+    delay_until(edge);
+    gpio_clear(HVSP_PORT, HVSP_SCI);
+  }
+  irq_wire_end(basepri);
+  prof_end(PROF_FRAME_SHIFT);
+
+  return sdo;
+}
+
+/**
+  * @brief  Samples the ready flag (SDO high).
+  * @param  None
+  * @retval 1 when the target is ready, 0 while it is busy
+  */
+int hvsp_ready(void)
+{
+  return gpio_read(HVSP_PORT, HVSP_SDO) != 0U;
+}
+
+/**
+  * @brief  Waits for the target to finish a programming operation.
+  * @param  timeout_us: give-up time
+  * @retval 0 when ready, -1 on timeout
+  */
+int hvsp_wait_ready(uint32_t timeout_us)
+{
+  uint32_t start = delay_now();
+  uint32_t limit = timeout_us * delay_cycles_per_us;
+  int rc = 0;
+
+  prof_begin(PROF_PAGE_WRITE_WAIT);
+  while (!hvsp_ready())
+  {
+    if (delay_now() - start > limit)
+    {
+      rc = -1;
+      break;
+    }
+  }
+  prof_end(PROF_PAGE_WRITE_WAIT);
+
+  return rc;
+}
+
+/**
+  * @brief  Starts a chip erase. The target is busy afterwards.
+  */
+void hvsp_chip_erase(void)
+{
+  hvsp_frame(HVSP_CMD_CHIP_ERASE, 0x4CU);
+  hvsp_frame(0x00U, 0x64U);
+  hvsp_frame(0x00U, 0x6CU);
+  hvsp_cmd = HVSP_CMD_NONE;
+}
+
+/**
+  * @brief  Forgets the cached Load Command, so the next operation sends it
+  *         again. Used after an error, when the target may have missed it.
+  * @param  None
+  * @retval None
+  */
+void hvsp_resync(void)
+{
+  hvsp_cmd = HVSP_CMD_NONE;
+}
+
+/**
+  * @brief  Loads one word into the flash page buffer.
+  * @param  addr: word address, only the in-page bits matter
+  * @param  word: data
+  */
+void hvsp_flash_load_word(uint16_t addr, uint16_t word)
+{
+  hvsp_load_cmd(HVSP_CMD_WRITE_FLASH);
+  hvsp_frame((uint8_t)addr, 0x0CU);
+  hvsp_frame((uint8_t)word, 0x2CU);
+  hvsp_frame((uint8_t)(word >> 8), 0x3CU);
+  hvsp_frame(0x00U, 0x7DU);
+  hvsp_frame(0x00U, 0x7CU);
+}
+
+/**
+  * @brief  Writes the page buffer to the page holding addr. The target is
+  *         busy afterwards.
+  * @param  addr: any word address inside the page
+  */
+void hvsp_flash_program_page(uint16_t addr)
+{
+  hvsp_frame((uint8_t)(addr >> 8), 0x1CU);
+  hvsp_frame(0x00U, 0x64U);
+  hvsp_frame(0x00U, 0x6CU);
+}
+
+/**
+  * @brief  Reads one flash word.
+  * @param  addr: word address
+  * @retval Word, low byte first in memory order
+  */
+uint16_t hvsp_flash_read_word(uint16_t addr)
+{
+  uint8_t lo;
+  uint8_t hi;
+
+  hvsp_load_cmd(HVSP_CMD_READ_FLASH);
+  hvsp_frame((uint8_t)addr, 0x0CU);
+  hvsp_frame((uint8_t)(addr >> 8), 0x1CU);
+  hvsp_frame(0x00U, 0x68U);
+  lo = hvsp_frame(0x00U, 0x6CU);
+  hvsp_frame(0x00U, 0x78U);
+  hi = hvsp_frame(0x00U, 0x7CU);
+
+  return (uint16_t)(lo | ((uint16_t)hi << 8));
+}
+
+/**
+  * @brief  Loads one byte into the EEPROM page buffer.
+  * @param  addr: byte address
+  * @param  data: value
+  */
+void hvsp_eeprom_load_byte(uint16_t addr, uint8_t data)
+{
+  hvsp_load_cmd(HVSP_CMD_WRITE_EEPROM);
+  hvsp_frame((uint8_t)addr, 0x0CU);
+  hvsp_frame((uint8_t)(addr >> 8), 0x1CU);
+  hvsp_frame(data, 0x2CU);
+  hvsp_frame(0x00U, 0x6DU);
+  hvsp_frame(0x00U, 0x6CU);
+}
+
+/**
+  * @brief  Writes the EEPROM page buffer. The target is busy afterwards.
+  */
+void hvsp_eeprom_program_page(void)
+{
+  hvsp_frame(0x00U, 0x64U);
+  hvsp_frame(0x00U, 0x6CU);
+}
+
+/**
+  * @brief  Reads one EEPROM byte.
+  * @param  addr: byte address
+  */
+uint8_t hvsp_eeprom_read_byte(uint16_t addr)
+{
+  hvsp_load_cmd(HVSP_CMD_READ_EEPROM);
+  hvsp_frame((uint8_t)addr, 0x0CU);
+  hvsp_frame((uint8_t)(addr >> 8), 0x1CU);
+  hvsp_frame(0x00U, 0x68U);
+  return hvsp_frame(0x00U, 0x6CU);
+}
+
+/**
+  * @brief  Writes a fuse byte. The target is busy afterwards.
+  */
+void hvsp_fuse_write(hvsp_fuse_t fuse, uint8_t value)
+{
+  static const uint8_t strobe[3][2] = { { 0x64U, 0x6CU }, { 0x74U, 0x7CU }, { 0x66U, 0x6EU } };
+
+  hvsp_frame(HVSP_CMD_WRITE_FUSE, 0x4CU);
+  hvsp_frame(value, 0x2CU);
+  hvsp_frame(0x00U, strobe[fuse][0]);
+  hvsp_frame(0x00U, strobe[fuse][1]);
+  hvsp_cmd = HVSP_CMD_NONE;
+}
+
+/**
+  * @brief  Reads a fuse byte.
+  */
+uint8_t hvsp_fuse_read(hvsp_fuse_t fuse)
+{
+  static const uint8_t strobe[3][2] = { { 0x68U, 0x6CU }, { 0x7AU, 0x7EU }, { 0x6AU, 0x6EU } };
+
+  hvsp_load_cmd(HVSP_CMD_READ_FUSE_LOCK);
+  hvsp_frame(0x00U, strobe[fuse][0]);
+  return hvsp_frame(0x00U, strobe[fuse][1]);
+}
+
+/**
+  * @brief  Writes the lock bits. The target is busy afterwards.
+  */
+void hvsp_lock_write(uint8_t value)
+{
+  hvsp_frame(HVSP_CMD_WRITE_LOCK, 0x4CU);
+  hvsp_frame(value, 0x2CU);
+  hvsp_frame(0x00U, 0x64U);
+  hvsp_frame(0x00U, 0x6CU);
+  hvsp_cmd = HVSP_CMD_NONE;
+}
+
+/**
+  * @brief  Reads the lock bits.
+  */
+uint8_t hvsp_lock_read(void)
+{
+  hvsp_load_cmd(HVSP_CMD_READ_FUSE_LOCK);
+  hvsp_frame(0x00U, 0x78U);
+  return hvsp_frame(0x00U, 0x7CU);
+}
+
+/**
+  * @brief  Reads one signature byte.
+  * @param  addr: 0..2
+  */
+uint8_t hvsp_signature_read(uint8_t addr)
+{
+  hvsp_load_cmd(HVSP_CMD_READ_SIG_CAL);
+  hvsp_frame(addr, 0x0CU);
+  hvsp_frame(0x00U, 0x68U);
+  return hvsp_frame(0x00U, 0x6CU);
+}
+
+/**
+  * @brief  Reads the oscillator calibration byte.
+  */
+uint8_t hvsp_calibration_read(void)
+{
+  hvsp_load_cmd(HVSP_CMD_READ_SIG_CAL);
+  hvsp_frame(0x00U, 0x0CU);
+  hvsp_frame(0x00U, 0x78U);
+  return hvsp_frame(0x00U, 0x7CU);
+}
@@ -1 +0,0 @@
-void _init(void) {}
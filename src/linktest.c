@@ -0,0 +1,169 @@
+/**
+  ******************************************************************************
+  * @file    linktest.c
+  * @brief   Host link self-test: sink, source and echo modes that measure
+  *          the transport without the programming logic.
+  *
+  *          CMD_LINK_TEST selects a mode and a byte count and is answered
+  *          normally. The main loop then hands every received chunk to
+  *          linktest_run() instead of the frame parser until the count is
+  *          used up: sink discards the bytes, echo sends them back, source
+  *          ignores input and streams count generated bytes. The protocol
+  *          resumes afterwards and CMD_LINK_STATS reads the counters.
+  ******************************************************************************
+  */
+
+#include "linktest.h"
+#include "timer.h"
+#include "usart.h"
+
+typedef struct
+{
+  uint32_t remaining;       /*!< bytes left in the running test            */
+  uint32_t rx_bytes;
+  uint32_t tx_bytes;
+  uint32_t rx_chunks;       /*!< reads handed over by the transport        */
+  uint32_t tx_chunks;       /*!< writes handed to the transport            */
+  uint64_t start;           /*!< timer_now_us() when the test started      */
+  uint32_t us;              /*!< duration of the last finished test        */
+  uint8_t mode;             /*!< linktest_mode_t                           */
+  uint8_t last_mode;
+} linktest_state_t;
+
+static linktest_state_t linktest;
+static uint8_t linktest_chunk[2][LINKTEST_CHUNK];
+static proto_write_t linktest_write;
+
+/**
+  * @brief  Sets the transport the source and echo modes send with.
+  * @param  write: transport send function
+  * @retval None
+  */
+void linktest_init(proto_write_t write)
+{
+  linktest_write = write;
+  linktest.mode = LINKTEST_OFF;
+}
+
+linktest_mode_t linktest_mode(void)
+{
+  return (linktest_mode_t)linktest.mode;
+}
+
+static void linktest_finish(void)
+{
+  linktest.us = (uint32_t)(timer_now_us() - linktest.start);
+  linktest.mode = LINKTEST_OFF;
+}
+
+/**
+  * @brief  Runs the active test on one received chunk. In source mode the
+  *         input is ignored and the next chunk of the stream is sent. Echo
+  *         sends from buf, which must stay valid as proto_write_t says.
+  * @param  buf: received bytes
+  * @param  len: number of bytes, may be 0
+  * @retval Bytes consumed; the rest belong to the frame parser
+  */
+uint16_t linktest_run(const uint8_t *buf, uint16_t len)
+{
+  uint16_t n;
+
+  if (linktest.mode == LINKTEST_SOURCE)
+  {
+    uint8_t *chunk = linktest_chunk[linktest.tx_chunks & 1U];
+
+    n = (linktest.remaining < LINKTEST_CHUNK) ? (uint16_t)linktest.remaining : LINKTEST_CHUNK;
+    for (uint16_t i = 0U; i < n; i++)
+    {
+      chunk[i] = (uint8_t)(linktest.tx_bytes + i);
+    }
+    linktest_write(chunk, n);
+    linktest.tx_bytes += n;
+    linktest.tx_chunks++;
+    linktest.remaining -= n;
+    if (linktest.remaining == 0U)
+    {
+      linktest_finish();
+    }
+    return 0U;
+  }
+
+  if (linktest.mode == LINKTEST_OFF || len == 0U)
+  {
+    return 0U;
+  }
+
+  n = (linktest.remaining < len) ? (uint16_t)linktest.remaining : len;
+  linktest.rx_bytes += n;
+  linktest.rx_chunks++;
+  if (linktest.mode == LINKTEST_ECHO)
+  {
+    linktest_write(buf, n);
+    linktest.tx_bytes += n;
+    linktest.tx_chunks++;
+  }
+  linktest.remaining -= n;
+  if (linktest.remaining == 0U)
+  {
+    linktest_finish();
+  }
+  return n;
+}
+
+/**
+  * @brief  CMD_LINK_TEST: mode, byte count (4 bytes, LSB first). Clears
+  *         the counters; the test starts once the answer is sent.
+  */
+uint8_t linktest_cmd_start(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint32_t count;
+
+  (void)data;
+
+  *data_len = 0U;
+  if (len < 6U || req[1] == LINKTEST_OFF || req[1] >= LINKTEST_MODES)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  count = (uint32_t)req[2] | ((uint32_t)req[3] << 8) | ((uint32_t)req[4] << 16) | ((uint32_t)req[5] << 24);
+  if (count == 0U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+
+  linktest.remaining = count;
+  linktest.rx_bytes = 0U;
+  linktest.tx_bytes = 0U;
+  linktest.rx_chunks = 0U;
+  linktest.tx_chunks = 0U;
+  linktest.us = 0U;
+  linktest.mode = req[1];
+  linktest.last_mode = req[1];
+  linktest.start = timer_now_us();
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_LINK_STATS: answers mode, rx bytes, tx bytes, rx chunks,
+  *         tx chunks, duration in ticks, the tick rate in Hz and the
+  *         receive ring laps since reset (4 bytes each, LSB first, after
+  *         the mode byte). Ticks are microseconds.
+  */
+uint8_t linktest_cmd_stats(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint8_t *p = data;
+
+  (void)req;
+  (void)len;
+
+  *p++ = linktest.last_mode;
+  p = proto_put_u32(p, linktest.rx_bytes);
+  p = proto_put_u32(p, linktest.tx_bytes);
+  p = proto_put_u32(p, linktest.rx_chunks);
+  p = proto_put_u32(p, linktest.tx_chunks);
+  p = proto_put_u32(p, linktest.us);
+  p = proto_put_u32(p, 1000000U);
+  p = proto_put_u32(p, usart_rx_laps());
+  *data_len = (uint16_t)(p - data);
+  return STATUS_CMD_OK;
+}
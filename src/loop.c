@@ -0,0 +1,226 @@
+/**
+  ******************************************************************************
+  * @file    loop.c
+  * @brief   Run loop: the host link, page pipeline and link event tasks.
+  *
+  *          Both are stackless coroutines (pt.h) sharing the one main stack.
+  *          Frames are parsed from the link in the PendSV bottom half
+  *          (irq.h), which the receive interrupts pend; the host task runs
+  *          the commands of complete frames. The page task waits for a
+  *          committed flash page in the background (prog_task()). A command
+  *          that needs the target waits for the page, anything else is
+  *          answered at once. The link task acts on DTR edges: when the
+  *          host opens the port the target is powered up ahead of its first
+  *          command (prog_link_opened()).
+  *
+  *          loop_poll() runs every task once. When all of them wait for an
+  *          interrupt the caller may sleep, see loop_pending(). The host
+  *          task runs first so the page task sees a page committed in the
+  *          same pass.
+  ******************************************************************************
+  */
+
+#include "loop.h"
+#include "irq.h"
+#include "linktest.h"
+#include "prof.h"
+#include "prog.h"
+#include "proto.h"
+#include "pt.h"
+#include "usart.h"
+
+static pt_t host_pt;
+static pt_t page_pt;
+static pt_t link_pt;
+
+/* Set by the bottom half when a frame is complete, cleared by the host
+   task once it is answered. The bottom half leaves the parser alone while
+   it is set, so the frame stays put for proto_process() */
+static volatile uint8_t loop_frame;
+/* Set while the host task feeds the parser itself (link self-test) */
+static volatile uint8_t loop_thread_parse;
+
+/* Receive chunk for the link self-test, two so echo can send from one */
+static uint8_t loop_chunk[2][LINKTEST_CHUNK];
+static uint8_t loop_which;
+
+/* Command ids that access the target, see stk500v2.h */
+static int loop_needs_target(uint8_t cmd)
+{
+  return cmd >= CMD_ENTER_PROGMODE_HVSP && cmd <= CMD_READ_OSCCAL_HVSP;
+}
+
+/**
+  * @brief  Bottom half: passes received bytes to the frame parser until a
+  *         frame is complete or the ring is empty. The link self-test
+  *         takes the bytes in thread mode instead. Without a free pool
+  *         buffer the bytes wait in the ring.
+  * @param  None
+  * @retval None
+  */
+void PendSV_Handler(void)
+{
+  int c;
+
+  if (loop_frame != 0U || loop_thread_parse != 0U || linktest_mode() != LINKTEST_OFF ||
+      !usart_rx_pending() || !proto_rx_ready())
+  {
+    return;
+  }
+
+  prof_begin(PROF_HOST_RX_PARSE);
+  while ((c = usart_getc()) >= 0)
+  {
+    if (proto_rx((uint8_t)c))
+    {
+      loop_frame = 1U;
+      break;
+    }
+  }
+  prof_end(PROF_HOST_RX_PARSE);
+}
+
+/**
+  * @brief  Link self-test step: hands up to a chunk of received bytes to
+  *         linktest_run() and the rest, once the test ends, to the parser.
+  */
+static void loop_linktest(void)
+{
+  uint8_t *chunk = loop_chunk[loop_which];
+  uint16_t n = 0U;
+  uint16_t used;
+  int c;
+
+  loop_thread_parse = 1U;
+  while (n < LINKTEST_CHUNK && (c = usart_getc()) >= 0)
+  {
+    chunk[n++] = (uint8_t)c;
+  }
+  if (n != 0U)
+  {
+    /* Echo may still be sending it: fill the other one next time */
+    loop_which ^= 1U;
+  }
+  used = linktest_run(chunk, n);
+  while (used < n)
+  {
+    if (proto_rx(chunk[used++]))
+    {
+      proto_process();
+      usart_commit();
+      if (linktest_mode() != LINKTEST_OFF)
+      {
+        used += linktest_run(&chunk[used], (uint16_t)(n - used));
+      }
+    }
+  }
+  loop_thread_parse = 0U;
+  /* The test may have ended with more frames waiting in the ring */
+  irq_defer();
+}
+
+/**
+  * @brief  Tells whether an interrupt handed the host task work: a parsed
+  *         frame, or link self-test data.
+  */
+static int loop_host_pending(void)
+{
+  return loop_frame != 0U || (linktest_mode() != LINKTEST_OFF && usart_rx_pending());
+}
+
+static PT_THREAD(host_task(pt_t *pt))
+{
+  PT_BEGIN(pt);
+  for (;;)
+  {
+    /* The receiver is off until autobaud has its sync byte */
+    PT_POLL_UNTIL(pt, !usart_autobaud_poll());
+    PT_WAIT_UNTIL(pt, loop_host_pending() || linktest_mode() == LINKTEST_SOURCE);
+
+    if (linktest_mode() != LINKTEST_OFF)
+    {
+      loop_linktest();
+      PT_YIELD(pt);
+      continue;
+    }
+
+    if (loop_needs_target(proto_rx_cmd()) && prog_busy())
+    {
+      prof_begin(PROF_PIPE_WAIT);
+      PT_POLL_UNTIL(pt, !prog_busy());
+      prof_end(PROF_PIPE_WAIT);
+    }
+    proto_process();
+    usart_commit();
+
+    loop_frame = 0U;
+    irq_defer();
+  }
+  PT_END(pt);
+}
+
+/**
+  * @brief  Link task: starts the target entry when the host opens the port.
+  *         Closing it is left to the keep-alive, since tools that reopen
+  *         the port for every run would otherwise power-cycle the target
+  *         between runs.
+  */
+static PT_THREAD(link_task(pt_t *pt))
+{
+  uint32_t event;
+
+  PT_BEGIN(pt);
+  for (;;)
+  {
+    PT_WAIT_UNTIL(pt, usart_link_event(&event));
+
+    if (event == USART_LINK_OPEN)
+    {
+      prog_link_opened();
+    }
+  }
+  PT_END(pt);
+}
+
+/**
+  * @brief  Starts the tasks. Call after proto_init() and prog_init().
+  * @param  None
+  * @retval None
+  */
+void loop_init(void)
+{
+  PT_INIT(&host_pt);
+  PT_INIT(&page_pt);
+  PT_INIT(&link_pt);
+  loop_which = 0U;
+  loop_frame = 0U;
+  loop_thread_parse = 0U;
+}
+
+/**
+  * @brief  Tells whether a task has work that an interrupt handed over: a
+  *         parsed frame or link self-test data, a keep-alive expiry or a
+  *         link event. Check it with interrupts masked before sleeping.
+  * @param  None
+  * @retval 1 when loop_poll() should run again
+  */
+int loop_pending(void)
+{
+  return loop_host_pending() || prog_pending() || usart_link_pending();
+}
+
+/**
+  * @brief  Runs every task once.
+  * @param  None
+  * @retval 1 while a task wants to run again, 0 when all wait for an
+  *         interrupt and the core may sleep
+  */
+int loop_poll(void)
+{
+  int busy = 0;
+
+  busy |= host_task(&host_pt) != PT_WAITING;
+  busy |= prog_task(&page_pt) != PT_WAITING;
+  busy |= link_task(&link_pt) != PT_WAITING;
+  return busy;
+}
@@ -1,64 +1,100 @@
-name: Build STM32 HVSP Programmer
+/**
+  ******************************************************************************
+  * @file    main.c
+  * @brief   HVSP programmer entry point: clock setup and the run loop.
+  ******************************************************************************
+  */
 
-on:
-  push:
-    branches: [ main, develop ]
-  pull_request:
-    branches: [ main ]
+#include "stm32f1xx.h"
+#include "arena.h"
+#include "bench.h"
+#include "boot.h"
+#include "delay.h"
+#include "irq.h"
+#include "linktest.h"
+#include "loop.h"
+#include "prof.h"
+#include "prog.h"
+#include "proto.h"
+#include "timer.h"
+#include "trace.h"
+#include "usart.h"
 
-jobs:
-  build:
-    runs-on: ubuntu-latest
-    
-    steps:
-    - name: Checkout repository
-      uses: actions/checkout@v4
-      
-    - name: Install ARM toolchain
-      run: |
-        sudo apt-get update
-        sudo apt-get install -y gcc-arm-none-eabi binutils-arm-none-eabi
-        
-    - name: Verify toolchain installation
-      run: |
-        arm-none-eabi-gcc --version
-        arm-none-eabi-as --version
-        arm-none-eabi-objcopy --version
-        
-    - name: Build project
-      run: |
-        make clean
-        make all
-        
-    - name: Check build artifacts
-      run: |
-        ls -la build/
-        file build/hvsp_programmer.elf
-        file build/hvsp_programmer.hex
-        file build/hvsp_programmer.bin
-        
-    - name: Upload build artifacts
-      uses: actions/upload-artifact@v4
-      with:
-        name: hvsp-programmer-firmware
-        path: |
-          build/hvsp_programmer.elf
-          build/hvsp_programmer.hex
-          build/hvsp_programmer.bin
-        retention-days: 30
-        
-    - name: Generate release info
-      if: github.ref == 'refs/heads/main'
-      run: |
-        echo "## Build Information" >> release_info.md
-        echo "- Commit: ${{ github.sha }}" >> release_info.md
-        echo "- Date: $(date)" >> release_info.md
-        echo "- Toolchain: $(arm-none-eabi-gcc --version | head -n1)" >> release_info.md
-        cat release_info.md
-        
-    - name: Upload release info
-      if: github.ref == 'refs/heads/main'
-      uses: actions/upload-artifact@v4
-      with:
-        name: release-info
-        path: release_info.md
+/**
+  * @brief  Switches SYSCLK to the PLL: 8 MHz HSE x 9 = 72 MHz, APB1 = 36 MHz,
+  *         APB2 = 72 MHz, two flash wait states with prefetch.
+  * @param  None
+  * @retval None
+  */
+static void SystemClock_Config(void)
+{
+  RCC->CR |= RCC_CR_HSEON;
+  while ((RCC->CR & RCC_CR_HSERDY) == 0U)
+  {
+  }
+
+  FLASH->ACR = FLASH_ACR_PRFTBE | FLASH_ACR_LATENCY_1;
+
+  RCC->CFGR = RCC_CFGR_PLLSRC | RCC_CFGR_PLLMULL9 | RCC_CFGR_PPRE1_DIV2;
+  RCC->CR |= RCC_CR_PLLON;
+  while ((RCC->CR & RCC_CR_PLLRDY) == 0U)
+  {
+  }
+
+  RCC->CFGR |= RCC_CFGR_SW_PLL;
+  while ((RCC->CFGR & RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL)
+  {
+  }
+
+  SystemCoreClockUpdate();
+}
+
+/**
+  * @brief  Sleeps until the next interrupt unless an interrupt handed over
+  *         work after the last loop pass. With PRIMASK set the pending
+  *         interrupt still ends WFI and runs once PRIMASK is cleared.
+  * @param  None
+  * @retval None
+  */
+static void main_idle(void)
+{
+  prof_begin(PROF_IDLE);
+  __disable_irq();
+  if (!loop_pending())
+  {
+    __WFI();
+  }
+  __enable_irq();
+  prof_end(PROF_IDLE);
+}
+
+int main(void)
+{
+#if defined(SIM_BENCH)
+  /* The emulator has no RCC to configure: stay on the reset clock */
+  bench_run();
+#endif
+
+  SystemClock_Config();
+  boot_mark(BOOT_PHASE_CLOCK_LOCK);
+
+  irq_init();
+  delay_init();
+  timer_init();
+  arena_init();
+  trace_init();
+  prog_init();
+  proto_init(usart_write);
+  linktest_init(usart_write);
+  loop_init();
+  usart_init(USART_BAUDRATE);
+  boot_mark(BOOT_PHASE_LINK_UP);
+
+  for (;;)
+  {
+    if (!loop_poll())
+    {
+      main_idle();
+    }
+  }
+}
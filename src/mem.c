@@ -0,0 +1,170 @@
+/**
+  ******************************************************************************
+  * @file    mem.c
+  * @brief   memcpy/memmove/memset/memcmp for the Cortex-M3.
+  *
+  *          When source and destination share their word alignment the
+  *          bulk moves in 16-byte LDM/STM bursts, as the startup code does
+  *          for .data and .bss; the rest goes by word, then by byte. LDM and
+  *          STM fault on unaligned addresses, so mismatched buffers are
+  *          copied bytewise. Loop distribution is off in this file: GCC
+  *          would otherwise turn the tail loops back into calls to the
+  *          function being defined.
+  ******************************************************************************
+  */
+
+#include <stdint.h>
+#include "mem.h"
+
+#undef memcpy
+#undef memmove
+#undef memset
+#undef memcmp
+
+#define MEM_FUNC  __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+/* Word access to byte buffers without breaking strict aliasing */
+typedef uint32_t __attribute__((may_alias)) mem_word_t;
+
+MEM_FUNC void *memcpy(void *dst, const void *src, size_t n)
+{
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+
+  if ((((uintptr_t)d ^ (uintptr_t)s) & 3U) == 0U)
+  {
+    while (((uintptr_t)d & 3U) != 0U && n != 0U)
+    {
+      *d++ = *s++;
+      n--;
+    }
+    if (n >= 16U)
+    {
+      __asm volatile (
+        "1: ldmia %1!, {r3, r4, r5, r12}  \n"
+        "   stmia %0!, {r3, r4, r5, r12}  \n"
+        "   subs  %2, %2, #16             \n"
+        "   cmp   %2, #16                 \n"
+        "   bhs   1b                      \n"
+        : "+r" (d), "+r" (s), "+r" (n)
+        :
+        : "r3", "r4", "r5", "r12", "cc", "memory");
+    }
+    while (n >= 4U)
+    {
+      *(mem_word_t *)d = *(const mem_word_t *)s;
+      d += 4;
+      s += 4;
+      n -= 4U;
+    }
+  }
+  while (n != 0U)
+  {
+    *d++ = *s++;
+    n--;
+  }
+  return dst;
+}
+
+MEM_FUNC void *memmove(void *dst, const void *src, size_t n)
+{
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+
+  /* A forward copy is safe unless dst starts inside src */
+  if ((uintptr_t)d - (uintptr_t)s >= n)
+  {
+    return memcpy(dst, src, n);
+  }
+
+  d += n;
+  s += n;
+  if ((((uintptr_t)d ^ (uintptr_t)s) & 3U) == 0U)
+  {
+    while (((uintptr_t)d & 3U) != 0U && n != 0U)
+    {
+      *--d = *--s;
+      n--;
+    }
+    while (n >= 4U)
+    {
+      d -= 4;
+      s -= 4;
+      *(mem_word_t *)d = *(const mem_word_t *)s;
+      n -= 4U;
+    }
+  }
+  while (n != 0U)
+  {
+    *--d = *--s;
+    n--;
+  }
+  return dst;
+}
+
+MEM_FUNC void *memset(void *dst, int c, size_t n)
+{
+  uint8_t *d = dst;
+  uint32_t word = (uint8_t)c * 0x01010101UL;
+
+  while (((uintptr_t)d & 3U) != 0U && n != 0U)
+  {
+    *d++ = (uint8_t)c;
+    n--;
+  }
+  if (n >= 16U)
+  {
+    __asm volatile (
+      "   mov   r3, %2                  \n"
+      "   mov   r4, %2                  \n"
+      "   mov   r5, %2                  \n"
+      "   mov   r12, %2                 \n"
+      "1: stmia %0!, {r3, r4, r5, r12}  \n"
+      "   subs  %1, %1, #16             \n"
+      "   cmp   %1, #16                 \n"
+      "   bhs   1b                      \n"
+      : "+r" (d), "+r" (n)
+      : "r" (word)
+      : "r3", "r4", "r5", "r12", "cc", "memory");
+  }
+  while (n >= 4U)
+  {
+    *(mem_word_t *)d = word;
+    d += 4;
+    n -= 4U;
+  }
+  while (n != 0U)
+  {
+    *d++ = (uint8_t)c;
+    n--;
+  }
+  return dst;
+}
+
+MEM_FUNC int memcmp(const void *a, const void *b, size_t n)
+{
+  const uint8_t *p = a;
+  const uint8_t *q = b;
+
+  /* Skip equal words; the differing one is resolved bytewise below */
+  if ((((uintptr_t)p | (uintptr_t)q) & 3U) == 0U)
+  {
+    while (n >= 4U && *(const mem_word_t *)p == *(const mem_word_t *)q)
+    {
+      p += 4;
+      q += 4;
+      n -= 4U;
+    }
+  }
+  while (n != 0U)
+  {
+    if (*p != *q)
+    {
+      return (int)*p - (int)*q;
+    }
+    p++;
+    q++;
+    n--;
+  }
+  return 0;
+}
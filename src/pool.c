@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file    pool.c
+  * @brief   Fixed pool of reference-counted frame buffers shared by the
+  *          parser, the command handlers, the page pipeline and the
+  *          transport.
+  *
+  *          A frame is received into a pool buffer, executed from it and
+  *          answered from another one; whoever still needs a buffer after
+  *          the command (the page pipeline, the transport) takes a
+  *          reference instead of a copy. Any pointer into a buffer names
+  *          it. The counts are updated with LDREX/STREX, so thread mode and
+  *          the PendSV parser share the pool without masking interrupts.
+  ******************************************************************************
+  */
+
+#include "pool.h"
+#include "stm32f1xx.h"
+
+static uint8_t pool_mem[POOL_COUNT][POOL_BUF_SIZE] __attribute__((aligned(4)));
+static volatile uint32_t pool_refs[POOL_COUNT];
+
+/**
+  * @brief  Buffer a pointer points into.
+  * @retval Buffer index, or POOL_COUNT when p is not in the pool
+  */
+static uint32_t pool_index(const void *p)
+{
+  uintptr_t off = (uintptr_t)p - (uintptr_t)pool_mem;
+
+  return (off < sizeof(pool_mem)) ? (uint32_t)(off / POOL_BUF_SIZE) : POOL_COUNT;
+}
+
+/**
+  * @brief  Takes a free buffer with one reference.
+  * @param  None
+  * @retval The buffer, or 0 when all are in use
+  */
+uint8_t *pool_get(void)
+{
+  for (uint32_t i = 0U; i < POOL_COUNT; i++)
+  {
+    for (;;)
+    {
+      if (__LDREXW(&pool_refs[i]) != 0U)
+      {
+        __CLREX();
+        break;
+      }
+      if (__STREXW(1U, &pool_refs[i]) == 0U)
+      {
+        __DMB();
+        return pool_mem[i];
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+  * @brief  Adds a reference to a buffer that is in use.
+  * @param  p: any pointer into the buffer
+  * @retval 0, or -1 when p is not in the pool
+  */
+int pool_ref(const void *p)
+{
+  uint32_t i = pool_index(p);
+  uint32_t refs;
+
+  if (i == POOL_COUNT)
+  {
+    return -1;
+  }
+  do
+  {
+    refs = __LDREXW(&pool_refs[i]);
+  } while (__STREXW(refs + 1U, &pool_refs[i]) != 0U);
+  return 0;
+}
+
+/**
+  * @brief  Drops a reference; the last one frees the buffer.
+  * @param  p: any pointer into the buffer, 0 and pointers outside the pool
+  *         are ignored
+  * @retval None
+  */
+void pool_put(const void *p)
+{
+  uint32_t i = pool_index(p);
+  uint32_t refs;
+
+  if (i == POOL_COUNT)
+  {
+    return;
+  }
+  __DMB();
+  do
+  {
+    refs = __LDREXW(&pool_refs[i]);
+  } while (__STREXW(refs - 1U, &pool_refs[i]) != 0U);
+}
@@ -0,0 +1,114 @@
+/**
+  ******************************************************************************
+  * @file    prof.c
+  * @brief   Per-phase cycle profiler on the DWT cycle counter.
+  ******************************************************************************
+  */
+
+#include "prof.h"
+#include "proto.h"
+
+#if defined(PROF_ENABLE)
+
+prof_counter_t prof_counters[PROF_COUNT];
+
+/**
+  * @brief  Folds one measurement into a counter.
+  * @param  id: counter
+  * @param  cycles: duration of the measured section
+  * @retval None
+  */
+void prof_record(prof_id_t id, uint32_t cycles)
+{
+  prof_counter_t *c = &prof_counters[id];
+
+  if (c->count == 0U || cycles < c->min)
+  {
+    c->min = cycles;
+  }
+  if (cycles > c->max)
+  {
+    c->max = cycles;
+  }
+  c->total += cycles;
+  c->count++;
+}
+
+#endif /* PROF_ENABLE */
+
+/**
+  * @brief  Clears every counter.
+  * @param  None
+  * @retval None
+  */
+void prof_reset(void)
+{
+#if defined(PROF_ENABLE)
+  for (uint32_t i = 0U; i < PROF_COUNT; i++)
+  {
+    prof_counters[i].count = 0U;
+    prof_counters[i].min = 0U;
+    prof_counters[i].max = 0U;
+    prof_counters[i].total = 0U;
+  }
+#endif /* PROF_ENABLE */
+}
+
+/**
+  * @brief  CMD_GET_PROFILE: for every counter count, min, max, avg and the
+  *         64-bit total, little-endian. Answers STATUS_CMD_FAILED when the
+  *         profiler is not built in.
+  */
+uint8_t prof_cmd_get(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)req;
+  (void)len;
+
+#if defined(PROF_ENABLE)
+  uint8_t *p = data;
+
+  /* Six u32 per counter; PROF_COUNT is an enumerator, out of reach of #if */
+  _Static_assert(PROF_COUNT * 24U <= PROTO_DATA_MAX, "the profile does not fit one answer");
+  for (uint32_t i = 0U; i < PROF_COUNT; i++)
+  {
+    const prof_counter_t *c = &prof_counters[i];
+    uint64_t total = c->total;
+    uint32_t count = c->count;
+
+    /* Scale both down until the total fits the 32-bit hardware divider,
+       there is no 64-bit division without libgcc */
+    while ((total >> 32) != 0U)
+    {
+      total >>= 1;
+      count >>= 1;
+    }
+
+    p = proto_put_u32(p, c->count);
+    p = proto_put_u32(p, c->min);
+    p = proto_put_u32(p, c->max);
+    p = proto_put_u32(p, (count != 0U) ? (uint32_t)total / count : 0U);
+    p = proto_put_u32(p, (uint32_t)c->total);
+    p = proto_put_u32(p, (uint32_t)(c->total >> 32));
+  }
+  *data_len = (uint16_t)(p - data);
+  return STATUS_CMD_OK;
+#else
+  (void)data;
+  *data_len = 0U;
+  return STATUS_CMD_FAILED;
+#endif /* PROF_ENABLE */
+}
+
+/**
+  * @brief  CMD_RESET_PROFILE: clears every counter.
+  */
+uint8_t prof_cmd_reset(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)req;
+  (void)len;
+  (void)data;
+
+  prof_reset();
+  *data_len = 0U;
+  return STATUS_CMD_OK;
+}
@@ -0,0 +1,1065 @@
+/**
+  ******************************************************************************
+  * @file    prog.c
+  * @brief   STK500v2 HVSP programming commands and the flash page pipeline.
+  ******************************************************************************
+  */
+
+#include "prog.h"
+#include "arena.h"
+#include "hvsp.h"
+#include "pool.h"
+#include "prof.h"
+#include "proto.h"
+#include "ring.h"
+#include "timer.h"
+#include "trace.h"
+
+/* PROGRAM_FLASH/EEPROM mode byte */
+#define MODE_PAGE                 0x01U   /* page mode, else byte mode */
+#define MODE_WRITE_PAGE           0x80U   /* commit the page after loading */
+
+/* Bit 31 of CMD_LOAD_ADDRESS asks for an extended address; ignored, no
+   HVSP part has more than 64K words */
+#define ADDRESS_MASK              0x0000FFFFUL
+
+static uint32_t prog_addr;
+static prog_page_state_t prog_page;
+static uint32_t prog_busy_timeout_ms;
+
+/* Error of a page completed by prog_task(), reported by the next command */
+static int prog_deferred_rc;
+static uint64_t prog_wait_start;
+
+/* Arena level when the target was powered up; everything a programming
+   session allocates is released when the target is powered down */
+static arena_mark_t prog_session;
+static prog_target_t prog_target;
+
+/* Keep-alive: after CMD_LEAVE_PROGMODE_HVSP the target stays in programming
+   mode for prog_keepalive x 100 ms (PARAM_HVSP_KEEPALIVE, 0 = power down at
+   once), so the next CMD_ENTER_PROGMODE_HVSP skips the power sequencing.
+   The timer only posts the expiry; prog_task() powers the target down. */
+#define PROG_EVENT_KEEPALIVE      1U
+
+static uint8_t prog_keepalive;
+static int prog_keepalive_slot;
+static uint32_t prog_events_buf[2];
+static ring_msg_t prog_events = RING_INIT(prog_events_buf);
+
+/* Target constants and settings read during a session, answered from here
+   until the target is powered down or a write changes them. Allocated from
+   the arena at power-up, 0 when it is full. */
+#define PROG_CACHE_SIG            0U    /* three signature bytes          */
+#define PROG_CACHE_FUSE           3U    /* low, high, extended fuse       */
+#define PROG_CACHE_LOCK           6U
+#define PROG_CACHE_OSCCAL         7U
+#define PROG_CACHE_SIZE           8U
+
+typedef struct
+{
+  uint8_t valid;                        /*!< bit n set when value[n] holds */
+  uint8_t value[PROG_CACHE_SIZE];
+} prog_cache_t;
+
+static prog_cache_t *prog_cache;
+
+/* Error recovery, off (0) unless the host sets PARAM_HVSP_RETRIES. With N
+   retries every read is repeated until two agree, each committed flash
+   page is read back and rewritten on a mismatch, and a busy timeout is
+   waited out N more times. */
+static uint8_t prog_retries;
+
+/* Words loaded since the last commit, for the read-back. They stay in the
+   request frames they arrived in, held from the pool */
+typedef struct
+{
+  const uint8_t *data;      /*!< little-endian words                       */
+  uint16_t words;
+} prog_seg_t;
+
+static prog_seg_t prog_page_segs[PROG_PAGE_SEGS];
+static uint8_t prog_page_nsegs;
+static uint16_t prog_page_base;
+static uint16_t prog_page_count;
+
+/**
+  * @brief  Notes a retry in the trace and invalidates the cached target
+  *         command, which a corrupted frame may have replaced.
+  */
+static void prog_retry(prog_retry_t op, uint8_t attempt)
+{
+  trace_event(TRACE_RETRY, (uint8_t)op, attempt);
+  hvsp_resync();
+}
+
+/**
+  * @brief  Waits out up to prog_retries more timeouts after a first one.
+  * @param  timeout_ms: one poll timeout
+  * @retval 0 when the target is ready, -1 on timeout
+  */
+static int prog_retry_ready(uint32_t timeout_ms)
+{
+  int rc = -1;
+
+  if (prog_retries != 0U)
+  {
+    prof_begin(PROF_RETRY);
+    for (uint8_t i = 0U; i < prog_retries && rc != 0; i++)
+    {
+      prog_retry(PROG_RETRY_BUSY, i);
+      rc = hvsp_wait_ready(timeout_ms * 1000U);
+    }
+    prof_end(PROF_RETRY);
+  }
+  return rc;
+}
+
+/**
+  * @brief  hvsp_wait_ready() with prog_retries extra timeouts.
+  * @param  timeout_ms: one poll timeout
+  * @retval 0 when the target is ready, -1 on timeout
+  */
+static int prog_wait_ready(uint32_t timeout_ms)
+{
+  return (hvsp_wait_ready(timeout_ms * 1000U) == 0) ? 0 : prog_retry_ready(timeout_ms);
+}
+
+/**
+  * @brief  Reads a flash word, repeating until two reads agree.
+  */
+static uint16_t prog_read_word(uint16_t addr)
+{
+  uint16_t word = hvsp_flash_read_word(addr);
+
+  if (prog_retries != 0U)
+  {
+    uint16_t again = hvsp_flash_read_word(addr);
+
+    if (again != word)
+    {
+      prof_begin(PROF_RETRY);
+      for (uint8_t i = 0U; i < prog_retries && again != word; i++)
+      {
+        prog_retry(PROG_RETRY_READ, i);
+        word = again;
+        again = hvsp_flash_read_word(addr);
+      }
+      prof_end(PROF_RETRY);
+    }
+    word = again;
+  }
+  return word;
+}
+
+/**
+  * @brief  Reads a byte through read(), repeating until two reads agree.
+  */
+static uint8_t prog_read_byte(uint8_t (*read)(uint16_t), uint16_t addr)
+{
+  uint8_t value = read(addr);
+
+  if (prog_retries != 0U)
+  {
+    uint8_t again = read(addr);
+
+    if (again != value)
+    {
+      prof_begin(PROF_RETRY);
+      for (uint8_t i = 0U; i < prog_retries && again != value; i++)
+      {
+        prog_retry(PROG_RETRY_READ, i);
+        value = again;
+        again = read(addr);
+      }
+      prof_end(PROF_RETRY);
+    }
+    value = again;
+  }
+  return value;
+}
+
+static uint8_t prog_read_signature(uint16_t addr)
+{
+  return hvsp_signature_read((uint8_t)addr);
+}
+
+/**
+  * @brief  Looks an entry up in the session cache.
+  * @param  entry: PROG_CACHE_xxx index
+  * @param  value: receives the cached value on a hit
+  * @retval 1 on a hit, 0 when the target has to be read
+  */
+static int prog_cache_get(uint8_t entry, uint8_t *value)
+{
+  if (prog_cache == 0 || (prog_cache->valid & (1U << entry)) == 0U)
+  {
+    return 0;
+  }
+  *value = prog_cache->value[entry];
+  return 1;
+}
+
+static void prog_cache_put(uint8_t entry, uint8_t value)
+{
+  if (prog_cache != 0)
+  {
+    prog_cache->value[entry] = value;
+    prog_cache->valid |= (uint8_t)(1U << entry);
+  }
+}
+
+static void prog_cache_drop(uint8_t entry)
+{
+  if (prog_cache != 0)
+  {
+    prog_cache->valid &= (uint8_t)~(1U << entry);
+  }
+}
+
+/**
+  * @brief  Reads a signature byte through the session cache.
+  */
+static uint8_t prog_signature(uint8_t addr)
+{
+  uint8_t value;
+
+  if (!prog_cache_get((uint8_t)(PROG_CACHE_SIG + addr), &value))
+  {
+    value = prog_read_byte(prog_read_signature, addr);
+    prog_cache_put((uint8_t)(PROG_CACHE_SIG + addr), value);
+  }
+  return value;
+}
+
+static void prog_target_state(prog_target_t state, uint16_t resumed)
+{
+  prog_target = state;
+  trace_event(TRACE_TARGET, (uint8_t)state, resumed);
+}
+
+/**
+  * @brief  Powers the target into programming mode and opens a session.
+  * @param  power_off_ms: time the target is held unpowered first
+  * @retval None
+  */
+static void prog_power_up(uint32_t power_off_ms)
+{
+  prog_session = arena_mark();
+  hvsp_enter(power_off_ms);
+  prog_cache = arena_alloc(sizeof(prog_cache_t));
+  if (prog_cache != 0)
+  {
+    prog_cache->valid = 0U;
+  }
+  prog_target_state(PROG_TARGET_ON, 0U);
+}
+
+/**
+  * @brief  Cancels the keep-alive and drops an expiry posted before the
+  *         cancel, so it cannot power down a later session.
+  * @param  None
+  * @retval None
+  */
+static void prog_keepalive_stop(void)
+{
+  timer_cancel(prog_keepalive_slot);
+  prog_keepalive_slot = -1;
+  prog_events.tail = prog_events.head;
+}
+
+/**
+  * @brief  Removes target power and closes the session.
+  * @param  None
+  * @retval None
+  */
+static void prog_power_down(void)
+{
+  prog_keepalive_stop();
+  hvsp_leave();
+  prog_cache = 0;
+  arena_release(prog_session);
+  prog_target_state(PROG_TARGET_OFF, 0U);
+}
+
+/**
+  * @brief  Takes a parked target back. The signature is read again and
+  *         compared with the cached one, so a target that lost power or
+  *         was replaced meanwhile is not programmed as the old one. Without
+  *         a cached signature to compare with nothing proves that, so the
+  *         target is powered up again.
+  * @param  None
+  * @retval 0 when the session continues, -1 if the target needs a power-up
+  */
+static int prog_resume(void)
+{
+  prog_keepalive_stop();
+  hvsp_resync();
+  for (uint8_t i = 0U; i < 3U; i++)
+  {
+    uint8_t cached;
+
+    if (!prog_cache_get((uint8_t)(PROG_CACHE_SIG + i), &cached) ||
+        prog_read_byte(prog_read_signature, i) != cached)
+    {
+      return -1;
+    }
+  }
+  prog_target_state(PROG_TARGET_ON, 1U);
+  return 0;
+}
+
+static void prog_keepalive_expired(void *arg)
+{
+  (void)arg;
+  (void)ring_msg_put(&prog_events, PROG_EVENT_KEEPALIVE);
+}
+
+/**
+  * @brief  Leaves a powered target in programming mode for the keep-alive,
+  *         with its signature cached for prog_resume(). Powers it down
+  *         instead when there is no cache or no free timer slot.
+  * @param  None
+  * @retval None
+  */
+static void prog_park(void)
+{
+  if (prog_cache == 0)
+  {
+    prog_power_down();
+    return;
+  }
+  for (uint8_t i = 0U; i < 3U; i++)
+  {
+    (void)prog_signature(i);
+  }
+  prog_keepalive_slot = timer_oneshot((uint32_t)prog_keepalive * 100000U, prog_keepalive_expired, 0);
+  if (prog_keepalive_slot >= 0)
+  {
+    prog_target_state(PROG_TARGET_PARKED, 0U);
+  }
+  else
+  {
+    prog_power_down();
+  }
+}
+
+/**
+  * @brief  Word i of the loaded page.
+  */
+static uint16_t prog_page_word(uint16_t i)
+{
+  const prog_seg_t *seg = prog_page_segs;
+
+  while (i >= seg->words)
+  {
+    i = (uint16_t)(i - seg->words);
+    seg++;
+  }
+  return (uint16_t)(seg->data[2U * i] | ((uint16_t)seg->data[2U * i + 1U] << 8));
+}
+
+/**
+  * @brief  Forgets the loaded words and releases their frames.
+  */
+static void prog_page_drop(void)
+{
+  for (uint8_t i = 0U; i < prog_page_nsegs; i++)
+  {
+    pool_put(prog_page_segs[i].data);
+  }
+  prog_page_nsegs = 0U;
+  prog_page_count = 0U;
+}
+
+/**
+  * @brief  Keeps words just loaded for the read-back by holding their
+  *         request frame. The page loaded so far is written unverified
+  *         when it arrives in more than PROG_PAGE_SEGS frames.
+  */
+static void prog_page_keep(const uint8_t *p, uint16_t words)
+{
+  if (prog_page_nsegs == PROG_PAGE_SEGS || pool_ref(p) != 0)
+  {
+    prog_page_drop();
+    return;
+  }
+  prog_page_segs[prog_page_nsegs].data = p;
+  prog_page_segs[prog_page_nsegs].words = words;
+  prog_page_nsegs++;
+  prog_page_count = (uint16_t)(prog_page_count + words);
+}
+
+/**
+  * @brief  Reads the committed page back and rewrites it while it differs.
+  *         Flash bits can only be cleared, so a page that got a 0 where a
+  *         1 belongs cannot be repaired without a chip erase.
+  * @retval 0 when the page matches, -1 if it still differs
+  */
+static int prog_verify_page(void)
+{
+  uint16_t last = (uint16_t)(prog_page_base + prog_page_count - 1U);
+  int rc = 0;
+
+  for (uint8_t attempt = 0U; ; attempt++)
+  {
+    uint16_t i = 0U;
+
+    while (i < prog_page_count && prog_read_word((uint16_t)(prog_page_base + i)) == prog_page_word(i))
+    {
+      i++;
+    }
+    if (i == prog_page_count)
+    {
+      break;
+    }
+    if (attempt == prog_retries)
+    {
+      rc = -1;
+      break;
+    }
+
+    prof_begin(PROF_RETRY);
+    prog_retry(PROG_RETRY_PAGE, attempt);
+    for (i = 0U; i < prog_page_count; i++)
+    {
+      hvsp_flash_load_word((uint16_t)(prog_page_base + i), prog_page_word(i));
+    }
+    hvsp_flash_program_page(last);
+    rc = hvsp_wait_ready(prog_busy_timeout_ms * 1000U);
+    prof_end(PROF_RETRY);
+    if (rc != 0)
+    {
+      break;
+    }
+  }
+  return rc;
+}
+
+/**
+  * @brief  Moves the page pipeline to a new state.
+  */
+static void prog_page_state(prog_page_state_t state)
+{
+  prog_page = state;
+  trace_event(TRACE_PAGE_STATE, (uint8_t)state, (uint16_t)prog_addr);
+}
+
+/**
+  * @brief  Closes a committed page once the target is ready (rc 0) or
+  *         has timed out, verifying it when retries are on.
+  * @retval 0, or -1 on a timeout or a page that still differs
+  */
+static int prog_finish_page(int rc)
+{
+  if (rc == 0 && prog_retries != 0U && prog_page_count != 0U)
+  {
+    rc = prog_verify_page();
+  }
+  prog_page_drop();
+  prog_page_state(PAGE_IDLE);
+  return rc;
+}
+
+/**
+  * @brief  Completes a deferred page write before the next target access.
+  *         The handlers call it only with the target ON: outside a session
+  *         opened by CMD_ENTER_PROGMODE_HVSP they fail with
+  *         STATUS_CMD_FAILED instead of clocking frames into a target that
+  *         is unpowered (or parked, until the host enters again).
+  * @param  None
+  * @retval 0 when the target is ready, -1 if the pending write (or one
+  *         completed by prog_task()) failed
+  */
+static int prog_sync(void)
+{
+  int rc = prog_deferred_rc;
+
+  prog_deferred_rc = 0;
+  if (prog_page == PAGE_WRITING && prog_finish_page(prog_wait_ready(prog_busy_timeout_ms)) != 0)
+  {
+    rc = -1;
+  }
+  return rc;
+}
+
+/**
+  * @brief  Page pipeline task: waits for a committed page in the
+  *         background, so the host link keeps being served meanwhile.
+  *         Retries after a timeout block, as they do in prog_sync().
+  *         Also powers a parked target down when its keep-alive runs out.
+  * @param  pt: task state
+  * @retval PT_WAITING or PT_YIELDED, see pt.h
+  */
+PT_THREAD(prog_task(pt_t *pt))
+{
+  uint32_t event;
+
+  PT_BEGIN(pt);
+  for (;;)
+  {
+    PT_WAIT_UNTIL(pt, prog_page == PAGE_WRITING || prog_pending());
+
+    if (ring_msg_get(&prog_events, &event))
+    {
+      if (event == PROG_EVENT_KEEPALIVE && prog_target == PROG_TARGET_PARKED)
+      {
+        prog_power_down();
+      }
+      continue;
+    }
+
+    prof_begin(PROF_PAGE_WRITE_WAIT);
+    prog_wait_start = timer_now_us();
+    PT_POLL_UNTIL(pt, hvsp_ready() ||
+                      timer_now_us() - prog_wait_start > prog_busy_timeout_ms * 1000U);
+    prof_end(PROF_PAGE_WRITE_WAIT);
+
+    if (prog_finish_page(hvsp_ready() ? 0 : prog_retry_ready(prog_busy_timeout_ms)) != 0)
+    {
+      prog_deferred_rc = -1;
+    }
+  }
+  PT_END(pt);
+}
+
+/**
+  * @brief  Tells whether a committed page is still being written.
+  * @param  None
+  * @retval 1 while the target is busy with a page
+  */
+int prog_busy(void)
+{
+  return prog_page == PAGE_WRITING;
+}
+
+/**
+  * @brief  The host opened the link: powers an unpowered target into
+  *         programming mode, reads its signature into the session cache and
+  *         parks it, so the host's CMD_ENTER_PROGMODE_HVSP and signature
+  *         reads find it ready. The keep-alive bounds the time at 12 V if
+  *         no command follows; without one nothing is done.
+  * @param  None
+  * @retval None
+  */
+void prog_link_opened(void)
+{
+  if (prog_target != PROG_TARGET_OFF || prog_keepalive == 0U || prog_busy())
+  {
+    return;
+  }
+  prog_power_up(PROG_LINK_POWER_OFF_MS);
+  prog_park();
+}
+
+/**
+  * @brief  Tells whether prog_task() has a keep-alive expiry to handle.
+  *         Check it with interrupts masked before sleeping.
+  * @param  None
+  * @retval 1 when loop_poll() should run again
+  */
+int prog_pending(void)
+{
+  return prog_events.head != prog_events.tail;
+}
+
+/**
+  * @brief  Waits for a write that is answered synchronously.
+  * @param  timeout_ms: STK500v2 pollTimeout, 0 for the default
+  * @retval Status byte for the answer
+  */
+static uint8_t prog_wait(uint8_t timeout_ms)
+{
+  uint32_t ms = (timeout_ms != 0U) ? timeout_ms : PROG_DEFAULT_TIMEOUT_MS;
+
+  return (prog_wait_ready(ms) == 0) ? STATUS_CMD_OK : STATUS_RDY_BSY_TOUT;
+}
+
+/**
+  * @brief  Resets the pipeline and puts the HVSP lines in their idle state.
+  * @param  None
+  * @retval None
+  */
+void prog_init(void)
+{
+  hvsp_init();
+  prog_addr = 0U;
+  prog_page = PAGE_IDLE;
+  prog_busy_timeout_ms = PROG_DEFAULT_TIMEOUT_MS;
+  prog_page_drop();
+  prog_deferred_rc = 0;
+  prog_target = PROG_TARGET_OFF;
+  prog_keepalive = PROG_KEEPALIVE_DEFAULT;
+  prog_keepalive_slot = -1;
+  prog_events.head = 0U;
+  prog_events.tail = 0U;
+  prog_cache = 0;
+}
+
+/**
+  * @brief  Sets the number of retries, PARAM_HVSP_RETRIES.
+  * @param  retries: 0 turns error recovery off
+  * @retval None
+  */
+void prog_set_retries(uint8_t retries)
+{
+  prog_retries = retries;
+}
+
+uint8_t prog_get_retries(void)
+{
+  return prog_retries;
+}
+
+/**
+  * @brief  Sets the keep-alive, PARAM_HVSP_KEEPALIVE. 0 also powers a
+  *         parked target down at once, which is how the host releases it.
+  * @param  keepalive: time in 100 ms units
+  * @retval None
+  */
+void prog_set_keepalive(uint8_t keepalive)
+{
+  prog_keepalive = keepalive;
+  if (keepalive == 0U && prog_target == PROG_TARGET_PARKED)
+  {
+    prog_power_down();
+  }
+}
+
+uint8_t prog_get_keepalive(void)
+{
+  return prog_keepalive;
+}
+
+/**
+  * @brief  CMD_LOAD_ADDRESS: 32-bit address, MSB first. Word address for
+  *         flash, byte address for EEPROM.
+  */
+uint8_t prog_cmd_load_address(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)data;
+
+  *data_len = 0U;
+  if (len < 5U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  prog_addr = (((uint32_t)req[1] << 24) | ((uint32_t)req[2] << 16) | ((uint32_t)req[3] << 8) | req[4]) & ADDRESS_MASK;
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_ENTER_PROGMODE_HVSP: stabDelay, cmdexeDelay, synchCycles,
+  *         latchCycles, toggleVtg, powoffDelay, resetDelay1, resetDelay2.
+  *         Only powoffDelay (ms) is used, the rest of the sequence follows
+  *         the datasheet timing. A parked target is taken back without
+  *         power sequencing; entering again from inside a session
+  *         power-cycles the target as before.
+  */
+uint8_t prog_cmd_enter(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)data;
+
+  *data_len = 0U;
+  if (prog_target == PROG_TARGET_ON || (prog_target == PROG_TARGET_PARKED && prog_resume() != 0))
+  {
+    prog_power_down();
+  }
+  if (prog_target == PROG_TARGET_OFF)
+  {
+    prog_power_up((len > 6U) ? req[6] : 0U);
+  }
+  prog_page = PAGE_IDLE;
+  prog_page_drop();
+  /* A failed write of the last session is not this session's error */
+  prog_deferred_rc = 0;
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_LEAVE_PROGMODE_HVSP: stabDelay, resetDelay. With a keep-alive
+  *         the target is parked in programming mode instead of powered down;
+  *         after a failed write it is always powered down.
+  */
+uint8_t prog_cmd_leave(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  int rc = prog_sync();
+
+  (void)req;
+  (void)len;
+  (void)data;
+
+  *data_len = 0U;
+  if (prog_target == PROG_TARGET_ON && rc == 0 && prog_keepalive != 0U)
+  {
+    prog_park();
+  }
+  else
+  {
+    prog_power_down();
+  }
+  return (rc == 0) ? STATUS_CMD_OK : STATUS_RDY_BSY_TOUT;
+}
+
+/**
+  * @brief  CMD_CHIP_ERASE_HVSP: pollTimeout, eraseTime.
+  */
+uint8_t prog_cmd_chip_erase(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)data;
+
+  *data_len = 0U;
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+  /* Erasing clears the lock bits, the fuses are kept */
+  prog_cache_drop(PROG_CACHE_LOCK);
+  hvsp_chip_erase();
+  return prog_wait((len > 1U) ? req[1] : 0U);
+}
+
+/**
+  * @brief  CMD_PROGRAM_FLASH_HVSP: NumBytes (MSB first), mode, pollTimeout,
+  *         data. Loads the words from the current address on and, with
+  *         MODE_WRITE_PAGE, commits the page without waiting for it.
+  */
+uint8_t prog_cmd_program_flash(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint16_t n;
+  const uint8_t *p = &req[5];
+
+  (void)data;
+
+  *data_len = 0U;
+  if (len < 5U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  n = (uint16_t)(((uint16_t)req[1] << 8) | req[2]);
+  if ((n & 1U) != 0U || len < 5U + n)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+
+  prof_begin(PROF_PAGE_LOAD);
+  prog_page_state(PAGE_LOADING);
+  if (prog_page_count == 0U)
+  {
+    prog_page_base = (uint16_t)prog_addr;
+  }
+  for (uint16_t i = 0U; i < n; i += 2U)
+  {
+    hvsp_flash_load_word((uint16_t)prog_addr, (uint16_t)(p[i] | ((uint16_t)p[i + 1U] << 8)));
+    prog_addr++;
+  }
+  prof_end(PROF_PAGE_LOAD);
+  if (prog_retries != 0U && n != 0U)
+  {
+    prog_page_keep(p, n / 2U);
+  }
+
+  if ((req[3] & MODE_WRITE_PAGE) != 0U && n != 0U)
+  {
+    hvsp_flash_program_page((uint16_t)(prog_addr - 1U));
+    prog_busy_timeout_ms = (req[4] != 0U) ? req[4] : PROG_DEFAULT_TIMEOUT_MS;
+    prog_page_state(PAGE_WRITING);
+  }
+  else
+  {
+    prog_page_state(PAGE_IDLE);
+  }
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_READ_FLASH_HVSP: NumBytes (MSB first). Answers with the data
+  *         and a second status byte.
+  */
+uint8_t prog_cmd_read_flash(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint16_t n;
+
+  *data_len = 0U;
+  if (len < 3U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  n = (uint16_t)(((uint16_t)req[1] << 8) | req[2]);
+  if ((n & 1U) != 0U || n + 1U > PROTO_DATA_MAX)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+
+  for (uint16_t i = 0U; i < n; i += 2U)
+  {
+    uint16_t word = prog_read_word((uint16_t)prog_addr);
+
+    data[i] = (uint8_t)word;
+    data[i + 1U] = (uint8_t)(word >> 8);
+    prog_addr++;
+  }
+  data[n] = STATUS_CMD_OK;
+  *data_len = n + 1U;
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_PROGRAM_EEPROM_HVSP: NumBytes (MSB first), mode, pollTimeout,
+  *         data. Byte mode writes and waits for every byte; page mode loads
+  *         the buffer and writes it with MODE_WRITE_PAGE.
+  */
+uint8_t prog_cmd_program_eeprom(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint16_t n;
+  uint8_t mode;
+  uint8_t status = STATUS_CMD_OK;
+
+  (void)data;
+
+  *data_len = 0U;
+  if (len < 5U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  n = (uint16_t)(((uint16_t)req[1] << 8) | req[2]);
+  mode = req[3];
+  if (len < 5U + n)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+
+  for (uint16_t i = 0U; i < n && status == STATUS_CMD_OK; i++)
+  {
+    hvsp_eeprom_load_byte((uint16_t)prog_addr, req[5U + i]);
+    prog_addr++;
+    if ((mode & MODE_PAGE) == 0U)
+    {
+      hvsp_eeprom_program_page();
+      status = prog_wait(req[4]);
+    }
+  }
+  if ((mode & MODE_PAGE) != 0U && (mode & MODE_WRITE_PAGE) != 0U)
+  {
+    hvsp_eeprom_program_page();
+    status = prog_wait(req[4]);
+  }
+  return status;
+}
+
+/**
+  * @brief  CMD_READ_EEPROM_HVSP: NumBytes (MSB first). Answers with the data
+  *         and a second status byte.
+  */
+uint8_t prog_cmd_read_eeprom(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint16_t n;
+
+  *data_len = 0U;
+  if (len < 3U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  n = (uint16_t)(((uint16_t)req[1] << 8) | req[2]);
+  if (n + 1U > PROTO_DATA_MAX)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+
+  for (uint16_t i = 0U; i < n; i++)
+  {
+    data[i] = prog_read_byte(hvsp_eeprom_read_byte, (uint16_t)prog_addr);
+    prog_addr++;
+  }
+  data[n] = STATUS_CMD_OK;
+  *data_len = n + 1U;
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_PROGRAM_FUSE_HVSP: address, fuseByte, pulseWidth, pollTimeout.
+  */
+uint8_t prog_cmd_program_fuse(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)data;
+
+  *data_len = 0U;
+  if (len < 5U || req[1] > HVSP_FUSE_EXT)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+  prog_cache_drop((uint8_t)(PROG_CACHE_FUSE + req[1]));
+  hvsp_fuse_write((hvsp_fuse_t)req[1], req[2]);
+  return prog_wait(req[4]);
+}
+
+/**
+  * @brief  CMD_READ_FUSE_HVSP: address. Answers with the fuse byte.
+  */
+uint8_t prog_cmd_read_fuse(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  *data_len = 0U;
+  if (len < 2U || req[1] > HVSP_FUSE_EXT)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+  if (!prog_cache_get((uint8_t)(PROG_CACHE_FUSE + req[1]), &data[0]))
+  {
+    data[0] = hvsp_fuse_read((hvsp_fuse_t)req[1]);
+    prog_cache_put((uint8_t)(PROG_CACHE_FUSE + req[1]), data[0]);
+  }
+  *data_len = 1U;
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_PROGRAM_LOCK_HVSP: address, lockByte, pulseWidth, pollTimeout.
+  */
+uint8_t prog_cmd_program_lock(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)data;
+
+  *data_len = 0U;
+  if (len < 5U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+  prog_cache_drop(PROG_CACHE_LOCK);
+  hvsp_lock_write(req[2]);
+  return prog_wait(req[4]);
+}
+
+/**
+  * @brief  CMD_READ_LOCK_HVSP: address. Answers with the lock byte.
+  */
+uint8_t prog_cmd_read_lock(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)req;
+  (void)len;
+
+  *data_len = 0U;
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+  if (!prog_cache_get(PROG_CACHE_LOCK, &data[0]))
+  {
+    data[0] = hvsp_lock_read();
+    prog_cache_put(PROG_CACHE_LOCK, data[0]);
+  }
+  *data_len = 1U;
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_READ_SIGNATURE_HVSP: address. Answers with the signature byte.
+  */
+uint8_t prog_cmd_read_signature(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  *data_len = 0U;
+  if (len < 2U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+  data[0] = (req[1] < 3U) ? prog_signature(req[1]) : prog_read_byte(prog_read_signature, req[1]);
+  *data_len = 1U;
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_READ_OSCCAL_HVSP: address. Answers with the calibration byte.
+  */
+uint8_t prog_cmd_read_osccal(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)req;
+  (void)len;
+
+  *data_len = 0U;
+  if (prog_target != PROG_TARGET_ON)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (prog_sync() != 0)
+  {
+    return STATUS_RDY_BSY_TOUT;
+  }
+  if (!prog_cache_get(PROG_CACHE_OSCCAL, &data[0]))
+  {
+    data[0] = hvsp_calibration_read();
+    prog_cache_put(PROG_CACHE_OSCCAL, data[0]);
+  }
+  *data_len = 1U;
+  return STATUS_CMD_OK;
+}
@@ -0,0 +1,393 @@
+/**
+  ******************************************************************************
+  * @file    proto.c
+  * @brief   Host protocol: STK500v2 message framing and command dispatch.
+  *
+  *          Frame: MESSAGE_START, SEQ, SIZE_H, SIZE_L, TOKEN, body, CHECKSUM
+  *          where CHECKSUM is the XOR of every preceding byte. Answers echo
+  *          the sequence number and the command id followed by a status.
+  *
+  *          Requests are parsed straight into a pool buffer (pool.h) and
+  *          the handler runs on it in place; the answer is built in a
+  *          second buffer that the transport sends from. A handler that
+  *          needs its request after returning (the page pipeline) takes a
+  *          reference on it.
+  ******************************************************************************
+  */
+
+#include "proto.h"
+#include "arena.h"
+#include "boot.h"
+#include "linktest.h"
+#include "mem.h"
+#include "pool.h"
+#include "prof.h"
+#include "prog.h"
+#include "stack.h"
+#include "trace.h"
+#include "usart.h"
+
+/* Receive state machine */
+typedef enum
+{
+  RX_START = 0,
+  RX_SEQ,
+  RX_SIZE_H,
+  RX_SIZE_L,
+  RX_TOKEN,
+  RX_BODY,
+  RX_CHECKSUM
+} proto_rx_state_t;
+
+typedef struct
+{
+  uint8_t id;
+  proto_handler_t handler;
+} proto_cmd_t;
+
+static uint8_t cmd_sign_on(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+static uint8_t cmd_set_parameter(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+static uint8_t cmd_get_parameter(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len);
+
+static const proto_cmd_t proto_cmds[] =
+{
+  { CMD_SIGN_ON,                cmd_sign_on },
+  { CMD_SET_PARAMETER,          cmd_set_parameter },
+  { CMD_GET_PARAMETER,          cmd_get_parameter },
+  { CMD_LOAD_ADDRESS,           prog_cmd_load_address },
+  { CMD_ENTER_PROGMODE_HVSP,    prog_cmd_enter },
+  { CMD_LEAVE_PROGMODE_HVSP,    prog_cmd_leave },
+  { CMD_CHIP_ERASE_HVSP,        prog_cmd_chip_erase },
+  { CMD_PROGRAM_FLASH_HVSP,     prog_cmd_program_flash },
+  { CMD_READ_FLASH_HVSP,        prog_cmd_read_flash },
+  { CMD_PROGRAM_EEPROM_HVSP,    prog_cmd_program_eeprom },
+  { CMD_READ_EEPROM_HVSP,       prog_cmd_read_eeprom },
+  { CMD_PROGRAM_FUSE_HVSP,      prog_cmd_program_fuse },
+  { CMD_READ_FUSE_HVSP,         prog_cmd_read_fuse },
+  { CMD_PROGRAM_LOCK_HVSP,      prog_cmd_program_lock },
+  { CMD_READ_LOCK_HVSP,         prog_cmd_read_lock },
+  { CMD_READ_SIGNATURE_HVSP,    prog_cmd_read_signature },
+  { CMD_READ_OSCCAL_HVSP,       prog_cmd_read_osccal },
+  { CMD_GET_BOOT_TIMES,         boot_cmd_get_times },
+  { CMD_GET_PROFILE,            prof_cmd_get },
+  { CMD_RESET_PROFILE,          prof_cmd_reset },
+  { CMD_TRACE_DUMP,             trace_cmd_dump },
+  { CMD_TRACE_CLEAR,            trace_cmd_clear },
+  { CMD_LINK_TEST,              linktest_cmd_start },
+  { CMD_LINK_STATS,             linktest_cmd_stats },
+  { CMD_SET_BAUD,               usart_cmd_set_baud },
+  { CMD_ARENA_STATS,            arena_cmd_stats },
+  { CMD_STACK_STATS,            stack_cmd_stats },
+};
+
+/* Offset of the body in a frame buffer */
+#define FRAME_BODY        5U
+
+#if FRAME_BODY + PROTO_BODY_MAX + 1U > POOL_BUF_SIZE
+#error "POOL_BUF_SIZE does not hold a whole frame"
+#endif
+
+/* Parameters 0x90..0x9F, writable by the host and read back verbatim */
+#define PARAM_FIRST       PARAM_HW_VER
+#define PARAM_COUNT       16U
+
+static uint8_t proto_params[PARAM_COUNT];
+
+static proto_write_t proto_write;
+static proto_rx_state_t rx_state;
+static uint8_t rx_seq;
+static uint16_t rx_size;
+static uint16_t rx_count;
+static uint8_t rx_checksum;
+static uint8_t *rx_frame;     /* pool buffer being filled by proto_rx()      */
+static uint8_t *rx_done;      /* complete frame waiting for proto_process()  */
+static uint8_t *tx_prev;      /* last answer, the transport may still read it */
+
+/**
+  * @brief  Wraps an answer body that has already been placed at
+  *         tx_frame + FRAME_BODY and hands the frame to the transport.
+  *         The buffer's reference passes to the send; the previous answer
+  *         is released once this call has returned.
+  * @param  tx_frame: pool buffer holding the answer
+  * @param  len: body length
+  * @retval None
+  */
+static void proto_send(uint8_t *tx_frame, uint16_t len)
+{
+  uint8_t checksum = 0U;
+
+  tx_frame[0] = MESSAGE_START;
+  tx_frame[1] = rx_seq;
+  tx_frame[2] = (uint8_t)(len >> 8);
+  tx_frame[3] = (uint8_t)len;
+  tx_frame[4] = TOKEN;
+  for (uint16_t i = 0U; i < len + 5U; i++)
+  {
+    checksum ^= tx_frame[i];
+  }
+  tx_frame[len + 5U] = checksum;
+
+  prof_begin(PROF_LINK_TX);
+  proto_write(tx_frame, len + 6U);
+  prof_end(PROF_LINK_TX);
+  pool_put(tx_prev);
+  tx_prev = tx_frame;
+}
+
+/**
+  * @brief  Command id of the frame completed by the last proto_rx().
+  */
+uint8_t proto_rx_cmd(void)
+{
+  return rx_done[FRAME_BODY];
+}
+
+/**
+  * @brief  Makes sure the parser has a buffer for the next frame, so a
+  *         caller can leave bytes in its ring while the pool is empty.
+  * @param  None
+  * @retval 1 when proto_rx() can take bytes
+  */
+int proto_rx_ready(void)
+{
+  if (rx_frame == 0)
+  {
+    rx_frame = pool_get();
+  }
+  return rx_frame != 0;
+}
+
+/**
+  * @brief  Runs the handler for the frame completed by the last proto_rx()
+  *         call and sends the answer.
+  * @param  None
+  * @retval None
+  */
+void proto_process(void)
+{
+  const uint8_t *req = &rx_done[FRAME_BODY];
+  uint8_t *tx_frame = pool_get();
+  uint8_t *answer;
+  uint16_t data_len = 0U;
+  uint8_t status = STATUS_CMD_UNKNOWN;
+
+  if (tx_frame == 0)
+  {
+    /* Out of buffers (cannot happen within the POOL_COUNT budget): refuse
+       the command from its own buffer */
+    rx_done[FRAME_BODY + 1U] = STATUS_CMD_FAILED;
+    proto_send(rx_done, 2U);
+    rx_done = 0;
+    return;
+  }
+  answer = &tx_frame[FRAME_BODY];
+
+  trace_event(TRACE_CMD_START, req[0], rx_size);
+  for (uint32_t i = 0U; i < sizeof(proto_cmds) / sizeof(proto_cmds[0]); i++)
+  {
+    if (proto_cmds[i].id == req[0])
+    {
+      boot_mark(BOOT_PHASE_FIRST_CMD);
+      prof_begin(PROF_CMD_EXEC);
+      status = proto_cmds[i].handler(req, rx_size, &answer[2], &data_len);
+      prof_end(PROF_CMD_EXEC);
+      break;
+    }
+  }
+
+  trace_event(TRACE_CMD_END, req[0], status);
+
+  answer[0] = req[0];
+  answer[1] = status;
+  pool_put(rx_done);
+  rx_done = 0;
+  proto_send(tx_frame, data_len + 2U);
+}
+
+/**
+  * @brief  Releases the frame completed by the last proto_rx() call without
+  *         answering it.
+  * @param  None
+  * @retval None
+  */
+void proto_discard(void)
+{
+  pool_put(rx_done);
+  rx_done = 0;
+}
+
+/**
+  * @brief  Drops the partly received frame after the transport lost bytes;
+  *         the parser waits for the next MESSAGE_START.
+  * @param  None
+  * @retval None
+  */
+void proto_rx_abort(void)
+{
+  rx_state = RX_START;
+}
+
+/**
+  * @brief  Resets the receiver and sets the transport used for answers.
+  * @param  write: transport send function
+  * @retval None
+  */
+void proto_init(proto_write_t write)
+{
+  proto_write = write;
+  rx_state = RX_START;
+
+  proto_params[PARAM_HW_VER - PARAM_FIRST]         = 0x02U;
+  proto_params[PARAM_SW_MAJOR - PARAM_FIRST]       = 0x02U;
+  proto_params[PARAM_SW_MINOR - PARAM_FIRST]       = 0x0AU;
+  proto_params[PARAM_VTARGET - PARAM_FIRST]        = 50U;     /* 5.0 V */
+  proto_params[PARAM_TOPCARD_DETECT - PARAM_FIRST] = 0xFFU;   /* no top card */
+}
+
+/**
+  * @brief  Feeds one received byte into the frame parser. A frame with a bad
+  *         checksum is answered from here; a good one is left for
+  *         proto_process() so that parsing and execution can be timed apart.
+  * @param  byte: received byte
+  * @retval 1 when a complete frame is ready for proto_process(), else 0
+  */
+int proto_rx(uint8_t byte)
+{
+  switch (rx_state)
+  {
+    case RX_START:
+      /* Without a buffer the frame is dropped, see proto_rx_ready() */
+      if (byte == MESSAGE_START && proto_rx_ready())
+      {
+        rx_checksum = byte;
+        rx_state = RX_SEQ;
+      }
+      return 0;
+
+    case RX_SEQ:
+      rx_seq = byte;
+      rx_state = RX_SIZE_H;
+      break;
+
+    case RX_SIZE_H:
+      rx_size = (uint16_t)byte << 8;
+      rx_state = RX_SIZE_L;
+      break;
+
+    case RX_SIZE_L:
+      rx_size |= byte;
+      rx_state = (rx_size != 0U && rx_size <= PROTO_BODY_MAX) ? RX_TOKEN : RX_START;
+      break;
+
+    case RX_TOKEN:
+      rx_count = 0U;
+      rx_state = (byte == TOKEN) ? RX_BODY : RX_START;
+      break;
+
+    case RX_BODY:
+      rx_frame[FRAME_BODY + rx_count++] = byte;
+      if (rx_count == rx_size)
+      {
+        rx_state = RX_CHECKSUM;
+      }
+      break;
+
+    case RX_CHECKSUM:
+      rx_state = RX_START;
+      if (byte == rx_checksum)
+      {
+        rx_done = rx_frame;
+        rx_frame = 0;
+        return 1;
+      }
+      /* Answered from the rejected frame's own buffer */
+      rx_frame[FRAME_BODY] = ANSWER_CKSUM_ERROR;
+      rx_frame[FRAME_BODY + 1U] = STATUS_CKSUM_ERROR;
+      proto_send(rx_frame, 2U);
+      rx_frame = 0;
+      return 0;
+
+    default:
+      rx_state = RX_START;
+      return 0;
+  }
+
+  rx_checksum ^= byte;
+  return 0;
+}
+
+/**
+  * @brief  CMD_SIGN_ON: returns the programmer signature.
+  */
+static uint8_t cmd_sign_on(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  static const char signature[] = "STK500_2";
+
+  (void)req;
+  (void)len;
+
+  data[0] = sizeof(signature) - 1U;
+  memcpy(&data[1], signature, sizeof(signature) - 1U);
+  *data_len = sizeof(signature);
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_SET_PARAMETER: id, value.
+  */
+static uint8_t cmd_set_parameter(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)data;
+
+  *data_len = 0U;
+  if (len >= 3U && req[1] == PARAM_HVSP_RETRIES)
+  {
+    prog_set_retries(req[2]);
+    return STATUS_CMD_OK;
+  }
+  if (len >= 3U && req[1] == PARAM_HVSP_KEEPALIVE)
+  {
+    prog_set_keepalive(req[2]);
+    return STATUS_CMD_OK;
+  }
+  if (len < 3U || req[1] < PARAM_FIRST || req[1] >= PARAM_FIRST + PARAM_COUNT)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  proto_params[req[1] - PARAM_FIRST] = req[2];
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  CMD_GET_PARAMETER: id. Answers with the value.
+  */
+static uint8_t cmd_get_parameter(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  *data_len = 0U;
+  if (len < 2U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  if (req[1] == PARAM_BUILD_NUMBER_LOW || req[1] == PARAM_BUILD_NUMBER_HIGH)
+  {
+    data[0] = 0U;
+  }
+  else if (req[1] == PARAM_HVSP_RETRIES)
+  {
+    data[0] = prog_get_retries();
+  }
+  else if (req[1] == PARAM_HVSP_KEEPALIVE)
+  {
+    data[0] = prog_get_keepalive();
+  }
+  else if (req[1] >= PARAM_FIRST && req[1] < PARAM_FIRST + PARAM_COUNT)
+  {
+    data[0] = proto_params[req[1] - PARAM_FIRST];
+  }
+  else
+  {
+    return STATUS_CMD_FAILED;
+  }
+  *data_len = 1U;
+  return STATUS_CMD_OK;
+}
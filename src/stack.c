@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file    stack.c
+  * @brief   Stack high-water measurement.
+  *
+  *          The scan starts at the bottom of the reservation and stops at the
+  *          first word that differs from STACK_PAINT. A high-water mark equal
+  *          to the reservation means the stack reached (and may have run
+  *          past) _earena into the session arena.
+  ******************************************************************************
+  */
+
+#include "stack.h"
+#include "proto.h"
+#include "sections.h"
+#include "stm32f1xx.h"
+
+/**
+  * @brief  Bytes reserved for the stack by the linker script.
+  * @param  None
+  * @retval Size, 0 on the host build
+  */
+uint32_t stack_size(void)
+{
+#if defined(HOST_BUILD)
+  return 0U;
+#else
+  return (uint32_t)&_estack - (uint32_t)&_earena;
+#endif /* HOST_BUILD */
+}
+
+/**
+  * @brief  Deepest stack use since reset.
+  * @param  None
+  * @retval Bytes below _estack that were written, 0 on the host build
+  */
+uint32_t stack_high_water(void)
+{
+#if defined(HOST_BUILD)
+  return 0U;
+#else
+  const uint32_t *p = &_earena;
+
+  while ((p < &_estack) && (*p == STACK_PAINT))
+  {
+    p++;
+  }
+  return (uint32_t)&_estack - (uint32_t)p;
+#endif /* HOST_BUILD */
+}
+
+/**
+  * @brief  CMD_STACK_STATS: answers the stack reservation, the high-water
+  *         mark and the depth at this handler, u32 little-endian each.
+  */
+uint8_t stack_cmd_stats(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint8_t *p = data;
+  uint32_t depth = 0U;
+
+  (void)req;
+  (void)len;
+
+#if !defined(HOST_BUILD)
+  depth = (uint32_t)&_estack - __get_MSP();
+#endif /* HOST_BUILD */
+  p = proto_put_u32(p, stack_size());
+  p = proto_put_u32(p, stack_high_water());
+  p = proto_put_u32(p, depth);
+  *data_len = (uint16_t)(p - data);
+  return STATUS_CMD_OK;
+}
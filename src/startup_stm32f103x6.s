@@ -60,42 +60,129 @@ defined in linker script */
   .type Reset_Handler, %function
 Reset_Handler:
 
+/* Start the DWT cycle counter first so that every boot phase is timed */
+    bl  boot_start
+
 /* Call the clock system initialization function.*/
     bl  SystemInit
+    movs r0, #0         /* BOOT_PHASE_SYSTEM_INIT */
+    bl  boot_mark
 
-/* Copy the data segment initializers from flash to SRAM */
+/* Copy the data segment initializers from flash to SRAM: four words per
+   LDM/STM burst, then the remaining words one at a time. The linker script
+   keeps _sdata, _edata and _sidata word aligned. */
   ldr r0, =_sdata
   ldr r1, =_edata
   ldr r2, =_sidata
-  movs r3, #0
+  subs r1, r1, r0
+  b LoopCopyDataBurst
+
+CopyDataBurst:
+  ldmia r2!, {r3, r4, r5, r6}
+  stmia r0!, {r3, r4, r5, r6}
+
+LoopCopyDataBurst:
+  subs r1, r1, #16
+  bcs CopyDataBurst
+  adds r1, r1, #16
   b LoopCopyDataInit
 
 CopyDataInit:
-  ldr r4, [r2, r3]
-  str r4, [r0, r3]
-  adds r3, r3, #4
+  ldr r3, [r2], #4
+  str r3, [r0], #4
 
 LoopCopyDataInit:
-  adds r4, r0, r3
-  cmp r4, r1
-  bcc CopyDataInit
-  
-/* Zero fill the bss segment. */
-  ldr r2, =_sbss
-  ldr r4, =_ebss
+  subs r1, r1, #4
+  bcs CopyDataInit
+  movs r0, #1         /* BOOT_PHASE_DATA_COPY */
+  bl  boot_mark
+
+/* Zero fill the bss segment, same burst scheme. .noinit follows .bss and
+   is deliberately left untouched. */
+  ldr r0, =_sbss
+  ldr r1, =_ebss
+  subs r1, r1, r0
   movs r3, #0
+  movs r4, #0
+  movs r5, #0
+  movs r6, #0
+  b LoopFillZerobssBurst
+
+FillZerobssBurst:
+  stmia r0!, {r3, r4, r5, r6}
+
+LoopFillZerobssBurst:
+  subs r1, r1, #16
+  bcs FillZerobssBurst
+  adds r1, r1, #16
   b LoopFillZerobss
 
 FillZerobss:
-  str  r3, [r2]
-  adds r2, r2, #4
+  str r3, [r0], #4
 
 LoopFillZerobss:
-  cmp r2, r4
-  bcc FillZerobss
+  subs r1, r1, #4
+  bcs FillZerobss
+  movs r0, #2         /* BOOT_PHASE_BSS_ZERO */
+  bl  boot_mark
+
+/* Paint the stack reservation below the current SP with STACK_PAINT
+   (stack.h) for the high-water measurement, same burst scheme. _earena
+   is 8-byte aligned and nothing below the SP is live yet. */
+  ldr r0, =_earena
+  mov r1, sp
+  subs r1, r1, r0
+  ldr r3, =0xC5C5C5C5
+  mov r4, r3
+  mov r5, r3
+  mov r6, r3
+  b LoopPaintStackBurst
+
+PaintStackBurst:
+  stmia r0!, {r3, r4, r5, r6}
+
+LoopPaintStackBurst:
+  subs r1, r1, #16
+  bcs PaintStackBurst
+  adds r1, r1, #16
+  b LoopPaintStack
+
+PaintStack:
+  str r3, [r0], #4
+
+LoopPaintStack:
+  subs r1, r1, #4
+  bcs PaintStack
+  movs r0, #3         /* BOOT_PHASE_STACK_PAINT */
+  bl  boot_mark
+
+/* Call static constructors. libc (and with it __libc_init_array) is not
+   linked, so walk .preinit_array and .init_array directly; both are empty
+   in a plain C build and cost only a compare each. */
+  ldr r4, =__preinit_array_start
+  ldr r5, =__preinit_array_end
+  b LoopCallPreinit
+
+CallPreinit:
+  ldr r3, [r4], #4
+  blx r3
+
+LoopCallPreinit:
+  cmp r4, r5
+  bcc CallPreinit
+
+  ldr r4, =__init_array_start
+  ldr r5, =__init_array_end
+  b LoopCallInit
+
+CallInit:
+  ldr r3, [r4], #4
+  blx r3
+
+LoopCallInit:
+  cmp r4, r5
+  bcc CallInit
 
-/* Call static constructors */
-    bl __libc_init_array
 /* Call the application's entry point.*/
   bl main
   bx lr
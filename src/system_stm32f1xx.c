@@ -112,6 +112,11 @@
                                                      This value must be a multiple of 0x200. */
 #endif /* VECT_TAB_OFFSET */
 
+#if defined(VECT_TAB_SRAM)
+#define VECT_TAB_SIZE           (16U + 43U)     /*!< Cortex-M3 exceptions plus STM32F103x6 IRQs
+                                                     (BootRAM word excluded). */
+#endif /* VECT_TAB_SRAM */
+
 #endif /* USER_VECT_TAB_ADDRESS */
 
 /******************************************************************************/
@@ -144,6 +149,15 @@ uint32_t SystemCoreClock = 8000000;
 const uint8_t AHBPrescTable[16U] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 6, 7, 8, 9};
 const uint8_t APBPrescTable[8U] =  {0, 0, 0, 0, 1, 2, 3, 4};
 
+#if defined(USER_VECT_TAB_ADDRESS) && defined(VECT_TAB_SRAM)
+  /* SRAM copy of g_pfnVectors. The ".ram_vector" section is placed at the
+     start of RAM by the linker script so it satisfies the VTOR alignment.
+     Once SystemInit() has switched VTOR, handlers can be replaced at run time
+     with the CMSIS NVIC_SetVector()/NVIC_GetVector() calls. */
+extern const uint32_t g_pfnVectors[];
+uint32_t g_pfnVectorsRam[VECT_TAB_SIZE] __attribute__((section(".ram_vector"), aligned(0x200)));
+#endif /* USER_VECT_TAB_ADDRESS && VECT_TAB_SRAM */
+
 /**
   * @}
   */
@@ -184,6 +198,14 @@ void SystemInit (void)
 
   /* Configure the Vector Table location -------------------------------------*/
 #if defined(USER_VECT_TAB_ADDRESS)
+#if defined(VECT_TAB_SRAM)
+  /* Copy the flash vector table before switching VTOR over to it */
+  for (uint32_t i = 0U; i < VECT_TAB_SIZE; i++)
+  {
+    g_pfnVectorsRam[i] = g_pfnVectors[i];
+  }
+  __DSB();
+#endif /* VECT_TAB_SRAM */
   SCB->VTOR = VECT_TAB_BASE_ADDRESS | VECT_TAB_OFFSET; /* Vector Table Relocation in Internal SRAM. */
 #endif /* USER_VECT_TAB_ADDRESS */
 }
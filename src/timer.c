@@ -0,0 +1,283 @@
+/**
+  ******************************************************************************
+  * @file    timer.c
+  * @brief   Microsecond time base on TIM2/TIM3: a 64-bit monotonic clock
+  *          and one-shot callbacks.
+  *
+  *          TIM2 counts microseconds from the live APB1 timer clock and
+  *          clocks TIM3 with its update event, so TIM3:TIM2 is a 32-bit
+  *          microsecond counter; the TIM3 update interrupt extends it to 64
+  *          bits. Call timer_clock_changed() (and delay_init()) after every
+  *          clock switch: the prescaler is derived again and the count
+  *          carries on.
+  *
+  *          One-shots compare on the low 16 bits with TIM2 channel 1; a
+  *          deadline further out than 65.536 ms matches on the way and is
+  *          armed again. Slots are claimed in thread mode only (not from
+  *          a callback) and released by the interrupt; only the interrupt
+  *          touches the compare register, so neither side masks interrupts.
+  ******************************************************************************
+  */
+
+#include "timer.h"
+#include "irq.h"
+#include "stm32f1xx.h"
+
+typedef struct
+{
+  uint64_t deadline;        /*!< timer_now_us() at or after which to fire */
+  timer_cb_t cb;
+  void *arg;
+  volatile uint8_t active;  /*!< set by timer_oneshot(), cleared on firing */
+} timer_slot_t;
+
+static timer_slot_t timer_slots[TIMER_SLOTS];
+
+#if !defined(HOST_BUILD)
+
+/* Upper 32 bits of the microsecond count */
+static volatile uint32_t timer_hi;
+
+/**
+  * @brief  TIM2/TIM3 input clock: PCLK1, doubled when APB1 is divided.
+  */
+static uint32_t timer_clock(void)
+{
+  uint32_t ppre1 = (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+  uint32_t pclk1 = SystemCoreClock >> APBPrescTable[ppre1];
+
+  return (APBPrescTable[ppre1] != 0U) ? pclk1 * 2U : pclk1;
+}
+
+/**
+  * @brief  Starts the time base at 0. Call after the clock is set up.
+  * @param  None
+  * @retval None
+  */
+void timer_init(void)
+{
+  RCC->APB1ENR |= RCC_APB1ENR_TIM2EN | RCC_APB1ENR_TIM3EN;
+
+  for (uint32_t i = 0U; i < TIMER_SLOTS; i++)
+  {
+    timer_slots[i].active = 0U;
+  }
+  timer_hi = 0U;
+
+  /* TIM3 counts TIM2 updates: ITR1 is TIM2 TRGO, external clock mode 1 */
+  TIM3->CR1 = 0U;
+  TIM3->PSC = 0U;
+  TIM3->ARR = 0xFFFFU;
+  TIM3->SMCR = TIM_SMCR_TS_0 | TIM_SMCR_SMS;
+  TIM3->EGR = TIM_EGR_UG;
+  TIM3->CNT = 0U;
+  TIM3->SR = 0U;
+  TIM3->DIER = TIM_DIER_UIE;
+
+  TIM2->CR1 = 0U;
+  TIM2->PSC = (uint16_t)(timer_clock() / 1000000U - 1U);
+  TIM2->ARR = 0xFFFFU;
+  TIM2->CR2 = TIM_CR2_MMS_1;
+  TIM2->EGR = TIM_EGR_UG;
+  TIM2->CNT = 0U;
+  TIM2->SR = 0U;
+  TIM2->DIER = 0U;
+
+  TIM3->CR1 = TIM_CR1_CEN;
+  TIM2->CR1 = TIM_CR1_CEN;
+
+  NVIC_SetPriority(TIM2_IRQn, IRQ_PRIO_TIMER);
+  NVIC_SetPriority(TIM3_IRQn, IRQ_PRIO_TIMER);
+  NVIC_EnableIRQ(TIM2_IRQn);
+  NVIC_EnableIRQ(TIM3_IRQn);
+}
+
+/**
+  * @brief  Loads the prescaler for a new core or APB1 clock. The count
+  *         stops for the few cycles this takes.
+  * @param  None
+  * @retval None
+  */
+void timer_clock_changed(void)
+{
+  uint16_t cnt;
+
+  TIM2->CR1 = 0U;
+  cnt = (uint16_t)TIM2->CNT;
+  TIM2->PSC = (uint16_t)(timer_clock() / 1000000U - 1U);
+  /* UG loads PSC but also clears CNT and would clock TIM3: restore both */
+  TIM3->CR1 = 0U;
+  TIM2->EGR = TIM_EGR_UG;
+  TIM2->CNT = cnt;
+  TIM2->SR = 0U;
+  TIM3->CR1 = TIM_CR1_CEN;
+  TIM2->CR1 = TIM_CR1_CEN;
+  /* A compare flag cleared above would be lost */
+  timer_hw_kick();
+}
+
+/**
+  * @brief  Microseconds since timer_init(). Safe in any context.
+  * @param  None
+  * @retval Monotonic time in us
+  */
+uint64_t timer_now_us(void)
+{
+  uint32_t hi;
+  uint16_t mid;
+  uint16_t lo;
+
+  do
+  {
+    hi = timer_hi;
+    mid = (uint16_t)TIM3->CNT;
+    lo = (uint16_t)TIM2->CNT;
+  } while (mid != (uint16_t)TIM3->CNT || hi != timer_hi);
+
+  /* TIM3 wrapped but its interrupt has not run yet (masked, or we are in
+     a handler of equal or higher priority) */
+  if ((TIM3->SR & TIM_SR_UIF) != 0U && mid < 0x8000U)
+  {
+    hi++;
+  }
+  return ((uint64_t)hi << 32) | ((uint32_t)mid << 16) | lo;
+}
+
+/**
+  * @brief  Lets the TIM2 interrupt arm the compare for new slots.
+  */
+void timer_hw_kick(void)
+{
+  NVIC_SetPendingIRQ(TIM2_IRQn);
+}
+
+/**
+  * @brief  TIM3 interrupt: the 32-bit count wrapped.
+  */
+void TIM3_IRQHandler(void)
+{
+  if ((TIM3->SR & TIM_SR_UIF) != 0U)
+  {
+    TIM3->SR = ~(uint32_t)TIM_SR_UIF;
+    timer_hi++;
+  }
+}
+
+/**
+  * @brief  Points TIM2 channel 1 at the earliest pending deadline.
+  */
+static void timer_arm(uint64_t next)
+{
+  if (next == UINT64_MAX)
+  {
+    TIM2->DIER &= ~TIM_DIER_CC1IE;
+    return;
+  }
+  TIM2->CCR1 = (uint16_t)next;
+  TIM2->DIER |= TIM_DIER_CC1IE;
+  if ((int64_t)(next - timer_now_us()) <= 0)
+  {
+    /* Already due, or the match went by while arming */
+    TIM2->EGR = TIM_EGR_CC1G;
+  }
+}
+
+#else
+
+/* The host build hands the next deadline to host/sim.c, which provides
+   timer_now_us() and timer_hw_kick() on simulated time */
+uint64_t timer_next_us = UINT64_MAX;
+
+void timer_init(void)
+{
+  for (uint32_t i = 0U; i < TIMER_SLOTS; i++)
+  {
+    timer_slots[i].active = 0U;
+  }
+  timer_next_us = UINT64_MAX;
+}
+
+void timer_clock_changed(void)
+{
+}
+
+static void timer_arm(uint64_t next)
+{
+  timer_next_us = next;
+}
+
+#endif /* HOST_BUILD */
+
+/**
+  * @brief  Calls cb(arg) from the TIM2 interrupt after delay_us.
+  * @param  delay_us: delay from now
+  * @param  cb: callback, runs in interrupt context
+  * @param  arg: passed to cb
+  * @retval Slot number for timer_cancel(), -1 when all slots are in use
+  */
+int timer_oneshot(uint32_t delay_us, timer_cb_t cb, void *arg)
+{
+  for (uint32_t i = 0U; i < TIMER_SLOTS; i++)
+  {
+    timer_slot_t *s = &timer_slots[i];
+
+    if (s->active == 0U)
+    {
+      s->deadline = timer_now_us() + delay_us;
+      s->cb = cb;
+      s->arg = arg;
+      __DMB();
+      s->active = 1U;
+      timer_hw_kick();
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/**
+  * @brief  Drops a pending one-shot. A callback that is already running
+  *         still completes.
+  * @param  slot: value returned by timer_oneshot(), -1 is ignored
+  * @retval None
+  */
+void timer_cancel(int slot)
+{
+  if (slot >= 0 && (uint32_t)slot < TIMER_SLOTS)
+  {
+    timer_slots[slot].active = 0U;
+    timer_hw_kick();
+  }
+}
+
+/**
+  * @brief  TIM2 interrupt: runs the callbacks that are due and arms the
+  *         compare for the next one.
+  */
+void TIM2_IRQHandler(void)
+{
+  uint64_t now;
+  uint64_t next = UINT64_MAX;
+
+  TIM2->SR = ~(uint32_t)TIM_SR_CC1IF;
+  now = timer_now_us();
+  for (uint32_t i = 0U; i < TIMER_SLOTS; i++)
+  {
+    timer_slot_t *s = &timer_slots[i];
+
+    if (s->active == 0U)
+    {
+      continue;
+    }
+    if (s->deadline <= now)
+    {
+      s->active = 0U;
+      s->cb(s->arg);
+    }
+    else if (s->deadline < next)
+    {
+      next = s->deadline;
+    }
+  }
+  timer_arm(next);
+}
@@ -0,0 +1,138 @@
+/**
+  ******************************************************************************
+  * @file    trace.c
+  * @brief   Timestamped binary event trace in a .noinit ring buffer.
+  ******************************************************************************
+  */
+
+#include "trace.h"
+#include "proto.h"
+#include "sections.h"
+#include "stm32f1xx.h"
+
+/* Records per CMD_TRACE_DUMP answer */
+#define TRACE_DUMP_MAX    32U
+
+#define TRACE_MAGIC       0x54524345UL    /* "TRCE" */
+
+typedef struct
+{
+  uint32_t magic;
+  volatile uint32_t head;   /*!< free-running count of claimed records */
+  trace_rec_t rec[TRACE_SIZE];
+} trace_buf_t;
+
+#if defined(TRACE_ENABLE)
+
+static trace_buf_t trace_buf __NOINIT;
+
+/**
+  * @brief  Keeps the ring left by a warm reset, or starts an empty one
+  *         after power-up, and logs TRACE_BOOT. boot_start() has restarted
+  *         the cycle counter, so the records before it have their own time
+  *         base.
+  * @param  None
+  * @retval None
+  */
+void trace_init(void)
+{
+  uint8_t warm = (trace_buf.magic == TRACE_MAGIC) ? 1U : 0U;
+
+  if (warm == 0U)
+  {
+    trace_buf.head = 0U;
+    trace_buf.magic = TRACE_MAGIC;
+  }
+  trace_event(TRACE_BOOT, warm, 0U);
+}
+
+/**
+  * @brief  Appends one record, overwriting the oldest when the ring is full.
+  * @param  event: event type
+  * @param  arg: event-specific byte
+  * @param  data: event-specific half-word
+  * @retval None
+  */
+void trace_event(trace_event_t event, uint8_t arg, uint16_t data)
+{
+  trace_rec_t *rec;
+  uint32_t idx;
+
+  do
+  {
+    idx = __LDREXW(&trace_buf.head);
+  } while (__STREXW(idx + 1U, &trace_buf.head) != 0U);
+
+  rec = &trace_buf.rec[idx & (TRACE_SIZE - 1U)];
+  rec->cycles = DWT->CYCCNT;
+  rec->event = (uint8_t)event;
+  rec->arg = arg;
+  rec->data = data;
+}
+
+#endif /* TRACE_ENABLE */
+
+/**
+  * @brief  CMD_TRACE_DUMP: first record index (u32). Answers with the head
+  *         index, the index of the first record returned (moved forward when
+  *         the requested one has been overwritten), HCLK in Hz, then up to
+  *         TRACE_DUMP_MAX 8-byte records. All fields little-endian.
+  */
+uint8_t trace_cmd_dump(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+#if defined(TRACE_ENABLE)
+  uint32_t head = trace_buf.head;
+  uint32_t first;
+  uint8_t *p = data;
+
+  if (len < 5U)
+  {
+    *data_len = 0U;
+    return STATUS_CMD_FAILED;
+  }
+
+  first = (uint32_t)req[1] | ((uint32_t)req[2] << 8) | ((uint32_t)req[3] << 16) | ((uint32_t)req[4] << 24);
+  if (head - first > TRACE_SIZE)
+  {
+    first = head - TRACE_SIZE;
+  }
+
+  p = proto_put_u32(p, head);
+  p = proto_put_u32(p, first);
+  p = proto_put_u32(p, SystemCoreClock);
+  for (uint32_t n = 0U; first != head && n < TRACE_DUMP_MAX; n++, first++)
+  {
+    const trace_rec_t *rec = &trace_buf.rec[first & (TRACE_SIZE - 1U)];
+
+    p = proto_put_u32(p, rec->cycles);
+    *p++ = rec->event;
+    *p++ = rec->arg;
+    p = proto_put_u16(p, rec->data);
+  }
+
+  *data_len = (uint16_t)(p - data);
+  return STATUS_CMD_OK;
+#else
+  (void)req;
+  (void)len;
+  (void)data;
+  *data_len = 0U;
+  return STATUS_CMD_FAILED;
+#endif /* TRACE_ENABLE */
+}
+
+/**
+  * @brief  CMD_TRACE_CLEAR: drops every record.
+  */
+uint8_t trace_cmd_clear(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  (void)req;
+  (void)len;
+  (void)data;
+
+#if defined(TRACE_ENABLE)
+  trace_buf.head = 0U;
+#endif /* TRACE_ENABLE */
+  *data_len = 0U;
+  return STATUS_CMD_OK;
+}
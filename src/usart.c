@@ -0,0 +1,451 @@
+/**
+  ******************************************************************************
+  * @file    usart.c
+  * @brief   USART1 host link (PA9 TX, PA10 RX) on DMA1: circular receive on
+  *          channel 5, transmit on channel 4.
+  *
+  *          The receive DMA writes the ring on its own, so there is no
+  *          interrupt per byte to disturb the HVSP timing. The IDLE line
+  *          interrupt (end of a host packet) and the half/full ring DMA
+  *          interrupts publish the DMA write position through an SPSC
+  *          ring (ring.h) and pend the parser in the bottom half (irq.h).
+  *          Both handlers run at IRQ_PRIO_LINK, so they never preempt each
+  *          other and act as one producer. Answers are sent by DMA straight from the
+  *          caller's buffer.
+  *
+  *          DTR# from the USB-serial bridge interrupts on both edges and
+  *          queues USART_LINK_OPEN/CLOSE events in a message ring, so the
+  *          main loop can get the target ready while the host is still
+  *          composing its first command.
+  *
+  *          With the 16x oversampling divider on the 72 MHz APB2 clock the
+  *          line runs at up to 4.5 Mbaud. CMD_SET_BAUD switches the rate
+  *          after its answer, or with rate 0 measures it from a 0x55 sync
+  *          byte sent by the host (autobaud): the start bit's falling edge
+  *          on PA10 (EXTI line 10) runs the measurement (autobaud.c) in the
+  *          interrupt, and the main loop only polls for the give-up time.
+  ******************************************************************************
+  */
+
+#include "usart.h"
+#include "autobaud.h"
+#include "board.h"
+#include "delay.h"
+#include "gpio.h"
+#include "irq.h"
+#include "proto.h"
+#include "ring.h"
+#include "trace.h"
+#include "stm32f1xx.h"
+
+/* Receive ring, written by DMA1 channel 5: a power of two that holds the
+   largest frame (body and six framing bytes) with room for the start of
+   the next while the parser waits for a pool buffer */
+#define USART_RX_SIZE     512U
+
+#if USART_RX_SIZE < PROTO_BODY_MAX + 6U
+#error "USART_RX_SIZE does not hold a whole frame"
+#endif
+
+static uint8_t rx_buf[USART_RX_SIZE];
+static ring_t rx_ring = RING_INIT(rx_buf);
+static uint32_t usart_pending;    /*!< requested rate, USART_PENDING_NONE if none */
+static uint32_t usart_laps;       /*!< times the DMA overwrote unread bytes */
+
+/* Autobaud in progress, thread mode only: set by usart_commit(), cleared
+   by usart_autobaud_poll() once the result is in */
+static uint8_t usart_autobaud;
+static uint32_t usart_autobaud_start;   /*!< delay_now() when it was armed */
+
+/* Autobaud results (the BRR in force), written by EXTI15_10_IRQHandler() */
+static uint32_t baud_events_buf[2];
+static ring_msg_t baud_events = RING_INIT(baud_events_buf);
+
+/* DTR# edges, written by EXTI9_5_IRQHandler() */
+static uint32_t link_events_buf[4];
+static ring_msg_t link_events = RING_INIT(link_events_buf);
+
+#define USART_PENDING_NONE    0xFFFFFFFFUL
+#define USART_PENDING_AUTO    0U
+
+/**
+  * @brief  APB2 clock, which USART1 runs on.
+  */
+static uint32_t usart_pclk(void)
+{
+  return SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos];
+}
+
+/**
+  * @brief  Configures PA9/PA10, USART1 for 8N1 at the given rate and both
+  *         DMA channels, and starts receiving. Call after the clock is set
+  *         up.
+  * @param  baudrate: line rate in bit/s
+  * @retval None
+  */
+void usart_init(uint32_t baudrate)
+{
+  RCC->APB2ENR |= RCC_APB2ENR_IOPAEN | RCC_APB2ENR_AFIOEN | RCC_APB2ENR_USART1EN;
+  RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+  /* PA9: alternate function push-pull 50 MHz, PA10: floating input */
+  GPIOA->CRH = (GPIOA->CRH & ~(GPIO_CRH_MODE9 | GPIO_CRH_CNF9 | GPIO_CRH_MODE10 | GPIO_CRH_CNF10))
+             | GPIO_CRH_MODE9 | GPIO_CRH_CNF9_1 | GPIO_CRH_CNF10_0;
+
+  rx_ring.head = 0U;
+  rx_ring.tail = 0U;
+  usart_laps = 0U;
+  usart_pending = USART_PENDING_NONE;
+
+  DMA1_Channel5->CCR = 0U;
+  DMA1_Channel5->CPAR = (uint32_t)&USART1->DR;
+  DMA1_Channel5->CMAR = (uint32_t)rx_buf;
+  DMA1_Channel5->CNDTR = USART_RX_SIZE;
+  DMA1_Channel5->CCR = DMA_CCR_PL_1 | DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE
+                     | DMA_CCR_EN;
+
+  DMA1_Channel4->CCR = 0U;
+  DMA1_Channel4->CPAR = (uint32_t)&USART1->DR;
+  DMA1->IFCR = DMA_IFCR_CGIF4 | DMA_IFCR_CGIF5;
+
+  USART1->BRR = (usart_pclk() + baudrate / 2U) / baudrate;
+  USART1->CR3 = USART_CR3_DMAR | USART_CR3_DMAT;
+  USART1->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE;
+
+  NVIC_SetPriority(USART1_IRQn, IRQ_PRIO_LINK);
+  NVIC_SetPriority(DMA1_Channel5_IRQn, IRQ_PRIO_LINK);
+  NVIC_EnableIRQ(USART1_IRQn);
+  NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+
+  /* PA8 (DTR#): input with pull-up, EXTI line 8 on port A, both edges. A
+     host that opened the port before the reset gets its event now. */
+  LINK_DTR_PORT->CRH = (LINK_DTR_PORT->CRH & ~(GPIO_CRH_MODE8 | GPIO_CRH_CNF8)) | GPIO_CRH_CNF8_1;
+  gpio_set(LINK_DTR_PORT, LINK_DTR);
+  AFIO->EXTICR[2] &= ~AFIO_EXTICR3_EXTI8;
+  EXTI->FTSR |= EXTI_FTSR_TR8;
+  EXTI->RTSR |= EXTI_RTSR_TR8;
+  EXTI->PR = EXTI_PR_PR8;
+  EXTI->IMR |= EXTI_IMR_MR8;
+  link_events.head = 0U;
+  link_events.tail = 0U;
+  if (gpio_read(LINK_DTR_PORT, LINK_DTR) == 0U)
+  {
+    (void)ring_msg_put(&link_events, USART_LINK_OPEN);
+  }
+  NVIC_SetPriority(EXTI9_5_IRQn, IRQ_PRIO_LINK);
+  NVIC_EnableIRQ(EXTI9_5_IRQn);
+
+  /* PA10 (RX): EXTI line 10 on port A, falling edge, unmasked only while
+     autobaud waits for its sync byte */
+  usart_autobaud = 0U;
+  baud_events.head = 0U;
+  baud_events.tail = 0U;
+  AFIO->EXTICR[2] &= ~AFIO_EXTICR3_EXTI10;
+  EXTI->IMR &= ~EXTI_IMR_MR10;
+  EXTI->FTSR |= EXTI_FTSR_TR10;
+  EXTI->PR = EXTI_PR_PR10;
+  NVIC_SetPriority(EXTI15_10_IRQn, IRQ_PRIO_LINK);
+  NVIC_EnableIRQ(EXTI15_10_IRQn);
+}
+
+/**
+  * @brief  Takes one byte from the receive ring. When the DMA has lapped
+  *         the consumer the unread bytes are discarded together with the
+  *         frame the parser was in, and the lap is counted.
+  * @param  None
+  * @retval The byte, or -1 when the ring is empty
+  */
+int usart_getc(void)
+{
+  uint16_t head = rx_ring.head;
+
+  if ((uint16_t)(head - rx_ring.tail) > USART_RX_SIZE)
+  {
+    usart_laps++;
+    rx_ring.tail = head;
+    proto_rx_abort();
+    return -1;
+  }
+  return ring_get(&rx_ring);
+}
+
+/**
+  * @brief  Number of times the receive DMA lapped the consumer since
+  *         usart_init().
+  */
+uint32_t usart_rx_laps(void)
+{
+  return usart_laps;
+}
+
+/**
+  * @brief  Tells whether usart_getc() has a byte, without taking it.
+  */
+int usart_rx_pending(void)
+{
+  return ring_count(&rx_ring) != 0U;
+}
+
+/**
+  * @brief  Takes the oldest link event.
+  * @param  event: receives USART_LINK_OPEN or USART_LINK_CLOSE
+  * @retval 1 with *event set, 0 when there is none
+  */
+int usart_link_event(uint32_t *event)
+{
+  return ring_msg_get(&link_events, event);
+}
+
+/**
+  * @brief  Tells whether usart_link_event() has an event, without taking it.
+  */
+int usart_link_pending(void)
+{
+  return link_events.head != link_events.tail;
+}
+
+/**
+  * @brief  Publishes what the receive DMA has written since the last call.
+  *         Runs in the IDLE and DMA interrupts only, at least every half
+  *         ring. The DMA fills the ring regardless of the consumer, so head
+  *         may run more than a ring ahead of tail; usart_getc() detects
+  *         that lap and counts it.
+  */
+static void usart_rx_publish(void)
+{
+  uint16_t pos = (uint16_t)((USART_RX_SIZE - DMA1_Channel5->CNDTR) & (USART_RX_SIZE - 1U));
+  uint16_t head = rx_ring.head;
+
+  ring_publish(&rx_ring, (uint16_t)(head + ((pos - head) & (USART_RX_SIZE - 1U))));
+}
+
+/**
+  * @brief  Waits for the previous transmission to leave the DMA channel.
+  */
+static void usart_tx_wait(void)
+{
+  if ((DMA1_Channel4->CCR & DMA_CCR_EN) != 0U)
+  {
+    while ((DMA1->ISR & DMA_ISR_TCIF4) == 0U)
+    {
+    }
+    DMA1_Channel4->CCR = 0U;
+    DMA1->IFCR = DMA_IFCR_CGIF4;
+  }
+}
+
+/**
+  * @brief  Starts sending a buffer by DMA once the previous one is out.
+  *         buf must stay valid until the next call returns.
+  * @param  buf: data to send
+  * @param  len: number of bytes
+  * @retval None
+  */
+void usart_write(const uint8_t *buf, uint16_t len)
+{
+  usart_tx_wait();
+  if (len == 0U)
+  {
+    return;
+  }
+  DMA1_Channel4->CMAR = (uint32_t)buf;
+  DMA1_Channel4->CNDTR = len;
+  DMA1_Channel4->CCR = DMA_CCR_PL_1 | DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+}
+
+/**
+  * @brief  Ends autobaud: sets the measured rate, or keeps the old one when
+  *         nothing usable was measured, turns the receiver back on and
+  *         posts the rate in force for usart_autobaud_poll().
+  * @param  cycles: result of autobaud_measure()
+  * @retval None
+  */
+static void usart_autobaud_finish(uint32_t cycles)
+{
+  uint32_t brr = autobaud_brr(cycles);
+
+  if (brr != 0U)
+  {
+    USART1->BRR = brr;
+  }
+  USART1->CR1 |= USART_CR1_RE;
+  (void)ring_msg_put(&baud_events, USART1->BRR);
+}
+
+/**
+  * @brief  Applies the rate change requested by CMD_SET_BAUD once its
+  *         answer has left the line. Call after proto_process(). Autobaud
+  *         only arms the sync byte interrupt; poll usart_autobaud_poll()
+  *         until it is done.
+  * @param  None
+  * @retval None
+  */
+void usart_commit(void)
+{
+  uint32_t rate = usart_pending;
+  uint32_t brr;
+
+  if (rate == USART_PENDING_NONE)
+  {
+    return;
+  }
+  usart_pending = USART_PENDING_NONE;
+
+  usart_tx_wait();
+  while ((USART1->SR & USART_SR_TC) == 0U)
+  {
+  }
+
+  if (rate == USART_PENDING_AUTO)
+  {
+    USART1->CR1 &= ~USART_CR1_RE;
+    autobaud_arm();
+    usart_autobaud_start = delay_now();
+    usart_autobaud = 1U;
+    EXTI->PR = EXTI_PR_PR10;
+    EXTI->IMR |= EXTI_IMR_MR10;
+    return;
+  }
+  brr = (usart_pclk() + rate / 2U) / rate;
+  USART1->BRR = brr;
+  trace_event(TRACE_BAUD, 0U, (uint16_t)brr);
+}
+
+/**
+  * @brief  Tells whether autobaud still waits for the sync byte, taking the
+  *         result from the interrupt once it is posted. Past
+  *         USART_AUTOBAUD_TIMEOUT_MS it raises the sync interrupt by
+  *         software, which gives up in the handler, so only the handler
+  *         ends autobaud.
+  * @param  None
+  * @retval 1 while autobaud is in progress
+  */
+int usart_autobaud_poll(void)
+{
+  uint32_t brr;
+
+  if (usart_autobaud == 0U)
+  {
+    return 0;
+  }
+  if (ring_msg_get(&baud_events, &brr))
+  {
+    usart_autobaud = 0U;
+    trace_event(TRACE_BAUD, 1U, (uint16_t)brr);
+    return 0;
+  }
+  if (delay_now() - usart_autobaud_start > USART_AUTOBAUD_TIMEOUT_MS * 1000U * delay_cycles_per_us)
+  {
+    EXTI->SWIER = EXTI_SWIER_SWIER10;
+  }
+  return 1;
+}
+
+/**
+  * @brief  CMD_SET_BAUD: rate in bit/s (4 bytes, LSB first), 0 for
+  *         autobaud. The answer goes out at the old rate; for autobaud the
+  *         host then sends 0x55 at the new rate and waits a frame before
+  *         talking.
+  */
+uint8_t usart_cmd_set_baud(const uint8_t *req, uint16_t len, uint8_t *data, uint16_t *data_len)
+{
+  uint32_t rate;
+
+  (void)data;
+
+  *data_len = 0U;
+  if (len < 5U)
+  {
+    return STATUS_CMD_FAILED;
+  }
+  rate = (uint32_t)req[1] | ((uint32_t)req[2] << 8) | ((uint32_t)req[3] << 16) | ((uint32_t)req[4] << 24);
+  /* 16x oversampling: 16 <= BRR <= 0xFFFF */
+  if (rate != USART_PENDING_AUTO && (rate > usart_pclk() / 16U || rate < usart_pclk() / 0xFFFFU + 1U))
+  {
+    return STATUS_CMD_FAILED;
+  }
+  usart_pending = rate;
+  return STATUS_CMD_OK;
+}
+
+/**
+  * @brief  USART1 interrupt: the line went idle after a host packet, which
+  *         is handed to the parser in the bottom half.
+  * @param  None
+  * @retval None
+  */
+void USART1_IRQHandler(void)
+{
+  trace_event(TRACE_ISR_ENTER, USART1_IRQn + 16, 0U);
+  if ((USART1->SR & USART_SR_IDLE) != 0U)
+  {
+    /* IDLE clears by reading SR then DR */
+    (void)USART1->DR;
+    usart_rx_publish();
+    irq_defer();
+  }
+  trace_event(TRACE_ISR_EXIT, USART1_IRQn + 16, 0U);
+}
+
+/**
+  * @brief  DMA1 channel 5 interrupt: the receive ring is half or completely
+  *         filled; hands what there is to the parser without waiting
+  *         for the line to go idle.
+  * @param  None
+  * @retval None
+  */
+void DMA1_Channel5_IRQHandler(void)
+{
+  trace_event(TRACE_ISR_ENTER, DMA1_Channel5_IRQn + 16, 0U);
+  DMA1->IFCR = DMA_IFCR_CGIF5;
+  usart_rx_publish();
+  irq_defer();
+  trace_event(TRACE_ISR_EXIT, DMA1_Channel5_IRQn + 16, 0U);
+}
+
+/**
+  * @brief  EXTI lines 5..9 interrupt: DTR# changed. The level after the
+  *         edge decides the event, so contact bounce ends in the right
+  *         state; a full ring drops the event.
+  * @param  None
+  * @retval None
+  */
+void EXTI9_5_IRQHandler(void)
+{
+  trace_event(TRACE_ISR_ENTER, EXTI9_5_IRQn + 16, 0U);
+  EXTI->PR = EXTI_PR_PR8;
+  (void)ring_msg_put(&link_events, (gpio_read(LINK_DTR_PORT, LINK_DTR) == 0U) ? USART_LINK_OPEN
+                                                                              : USART_LINK_CLOSE);
+  trace_event(TRACE_ISR_EXIT, EXTI9_5_IRQn + 16, 0U);
+}
+
+/**
+  * @brief  EXTI lines 10..15 interrupt: the start bit of the autobaud sync
+  *         byte on PA10, or the give-up time raised by usart_autobaud_poll().
+  * @param  None
+  * @retval None
+  */
+void EXTI15_10_IRQHandler(void)
+{
+  autobaud_sample_t sync;
+  uint32_t cycles = 0U;
+
+  /* The sync byte is already on the line: sample it before anything else,
+     and log the entry afterwards */
+  autobaud_sample(&sync);
+  if ((EXTI->IMR & EXTI_IMR_MR10) != 0U && (EXTI->SWIER & EXTI_SWIER_SWIER10) == 0U)
+  {
+    cycles = autobaud_measure(&sync);
+  }
+  trace_event(TRACE_ISR_ENTER, EXTI15_10_IRQn + 16, 0U);
+  /* Also clears SWIER */
+  EXTI->PR = EXTI_PR_PR10;
+  /* The unmasked line is the armed state: a second entry, pended by a
+     give-up that raced the sync byte, finds it masked and posts nothing */
+  if ((EXTI->IMR & EXTI_IMR_MR10) != 0U)
+  {
+    EXTI->IMR &= ~EXTI_IMR_MR10;
+    usart_autobaud_finish(cycles);
+  }
+  trace_event(TRACE_ISR_EXIT, EXTI15_10_IRQn + 16, 0U);
+}
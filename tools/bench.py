@@ -0,0 +1,323 @@
+#!/usr/bin/env python3
+"""End-to-end programming benchmark matrix on the host build.
+
+For every device x fill ratio x transport x PHY x compression combination,
+programs a random image into the simulated ATtiny, verifies it and
+collects:
+
+  - simulated program time, from the target model: from the first Write
+    Flash command to the end of the last page write, background page
+    writes included. Simulated time stands still while the programmer
+    waits for the host, so it does not depend on the transport or the
+    host CPU,
+  - simulated verify time, from the firmware's PROF_CMD_EXEC and
+    PROF_PIPE_WAIT counters; reads are answered synchronously, so this is
+    the time the reads held the target,
+  - per-phase profiler totals (frame shift, page load, page write wait, ...),
+  - wire utilisation from the programmer's -s analysis,
+  - link bytes in both directions and the wall-clock time.
+
+Results go to a JSON file. With --baseline, simulated times are compared
+with a stored run and any combination that got slower by more than
+--tolerance percent fails the run. So does one that got that much faster
+or is missing from the baseline: the stored run no longer matches what
+the tree produces and has to be rewritten with --update-baseline.
+
+A second section programs one device under each of FAULTS, with the
+firmware's HVSP retries enabled, and reports the throughput lost against
+the fault-free run together with the retry count and recovery latency
+(PROF_RETRY). Its times are not compared with the baseline. A dropped
+frame can program a 0 where a 1 belongs, which no rewrite repairs, so
+failures under faults are reported as unrecoverable; only a failure of
+the fault-free run fails the run.
+
+    make bench
+"""
+
+import argparse
+import itertools
+import json
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import stk500v2 as stk  # noqa: E402
+
+# flash bytes, page bytes
+DEVICES = {
+    "attiny13": (1024, 32),
+    "attiny24": (2048, 32),
+    "attiny44": (4096, 64),
+    "attiny84": (8192, 64),
+    "attiny25": (2048, 32),
+    "attiny45": (4096, 64),
+    "attiny85": (8192, 64),
+}
+
+# Only the bit-bang PHY and uncompressed images exist in the firmware; the
+# axes are kept so new backends only need an entry here.
+MATRIX = {
+    "device": ["attiny13", "attiny45", "attiny85"],
+    "fill": [0.1, 0.5, 1.0],
+    "transport": ["pipe", "pty"],
+    "phy": ["bitbang"],
+    "compression": ["off"],
+}
+
+# Target fault profiles for programmer -f, see tiny_parse_faults()
+FAULTS = {
+    "none": None,
+    "sdo": "sdo=2e-4",
+    "busy": "busy=0.05:6000",
+    "drop": "drop=1e-4",
+    "all": "sdo=2e-4,busy=0.05:6000,drop=1e-4",
+}
+FAULT_COMBO = ("attiny85", 1.0, "pipe", "bitbang", "off")
+FAULT_RETRIES = 3
+
+MODE_PAGE_WRITE = 0xC1
+READ_CHUNK = 256
+
+
+def make_image(size, page, fill, seed):
+    """Random pages up to the fill ratio, erased (0xFF) after that."""
+    rng = random.Random(seed)
+    used = int(round(size * fill / page)) * page
+    return bytes(rng.randrange(256) for _ in range(used)) + b"\xff" * (size - used)
+
+
+def session(image, page, retries=0):
+    """Command bodies of one session, with profile snapshots between phases.
+
+    Like avrdude, pages that are entirely 0xFF are not sent. The signature
+    read after the last page makes the firmware finish the deferred page
+    wait inside the program phase.
+    """
+    cmds = [
+        ("setup", [stk.CMD_SIGN_ON]),
+        ("setup", [stk.CMD_GET_BOOT_TIMES]),
+        ("setup", [stk.CMD_SET_PARAMETER, stk.PARAM_HVSP_RETRIES, retries]),
+        ("setup", [stk.CMD_ENTER_PROGMODE_HVSP, 100, 0, 0, 0, 0, 0, 0, 0]),
+        ("setup", [stk.CMD_READ_SIGNATURE_HVSP, 0]),
+        ("setup", [stk.CMD_CHIP_ERASE_HVSP, 0, 10]),
+        ("setup", [stk.CMD_RESET_PROFILE]),
+    ]
+    for off in range(0, len(image), page):
+        chunk = image[off:off + page]
+        if chunk == b"\xff" * page:
+            continue
+        word = off // 2
+        cmds.append(("program", [stk.CMD_LOAD_ADDRESS, 0, 0, word >> 8, word & 0xFF]))
+        cmds.append(("program", [stk.CMD_PROGRAM_FLASH_HVSP, page >> 8, page & 0xFF,
+                                 MODE_PAGE_WRITE, 10] + list(chunk)))
+    cmds.append(("program", [stk.CMD_READ_SIGNATURE_HVSP, 0]))
+    cmds.append(("program", [stk.CMD_GET_PROFILE]))
+    cmds.append(("program", [stk.CMD_RESET_PROFILE]))
+    cmds.append(("verify", [stk.CMD_LOAD_ADDRESS, 0, 0, 0, 0]))
+    for _ in range(0, len(image), READ_CHUNK):
+        cmds.append(("verify", [stk.CMD_READ_FLASH_HVSP, READ_CHUNK >> 8, READ_CHUNK & 0xFF]))
+    cmds.append(("verify", [stk.CMD_GET_PROFILE]))
+    cmds.append(("leave", [stk.CMD_LEAVE_PROGMODE_HVSP, 1, 1]))
+    return cmds
+
+
+def programmer_args(programmer, device, faults):
+    argv = [programmer, "-d", device, "-s"]
+    if faults:
+        argv += ["-f", "%s,seed=1" % faults]
+    return argv
+
+
+def run_pipe(programmer, device, cmds, faults=None):
+    stream = b"".join(stk.encode(i, body) for i, (_, body) in enumerate(cmds))
+    start = time.perf_counter()
+    proc = subprocess.run(programmer_args(programmer, device, faults), input=stream,
+                          capture_output=True)
+    wall = time.perf_counter() - start
+    answers = stk.decode_stream(proc.stdout)
+    return answers, proc.stderr.decode(), wall, len(stream), len(proc.stdout), proc.returncode
+
+
+def run_pty(programmer, device, cmds, faults=None):
+    link_path = os.path.join(tempfile.mkdtemp(), "ttyHVSP")
+    proc = subprocess.Popen(programmer_args(programmer, device, faults) + ["-l", link_path],
+                            stderr=subprocess.PIPE)
+    answers = []
+    sent = received = 0
+    try:
+        deadline = time.time() + 5
+        while not os.path.exists(link_path):
+            if time.time() > deadline or proc.poll() is not None:
+                raise RuntimeError("programmer did not open the link")
+            time.sleep(0.01)
+        with stk.Link(link_path, timeout=5.0) as link:
+            start = time.perf_counter()
+            for _, body in cmds:
+                status, data = link.command(body)
+                answers.append(bytes([body[0], status]) + bytes(data))
+                sent += len(body) + 6
+                received += len(data) + 8
+            wall = time.perf_counter() - start
+    finally:
+        proc.terminate()
+        _, err = proc.communicate()
+        if os.path.lexists(link_path):
+            os.unlink(link_path)
+        os.rmdir(os.path.dirname(link_path))
+    return answers, err.decode(), wall, sent, received, proc.returncode
+
+
+def run_one(args, combo, faults=None, retries=0):
+    device, fill, transport, phy, compression = combo
+    size, page = DEVICES[device]
+    image = make_image(size, page, fill, args.seed)
+    cmds = session(image, page, retries)
+
+    runner = run_pipe if transport == "pipe" else run_pty
+    answers, report, wall, sent, received, rc = runner(args.programmer, device, cmds, faults)
+    if len(answers) != len(cmds):
+        raise RuntimeError("%s: %d answers for %d commands" % (combo, len(answers), len(cmds)))
+
+    hclk = 72e6
+    profiles = {}
+    readback = b""
+    errors = 0
+    for (phase, body), answer in zip(cmds, answers):
+        if answer[1] != stk.STATUS_CMD_OK and faults:
+            errors += 1
+        elif answer[1] != stk.STATUS_CMD_OK:
+            raise RuntimeError("%s: command 0x%02x failed with 0x%02x" % (combo, body[0], answer[1]))
+        if body[0] == stk.CMD_GET_BOOT_TIMES:
+            hclk = float(int.from_bytes(answer[6:10], "little"))
+        elif body[0] == stk.CMD_GET_PROFILE:
+            profiles[phase] = stk.parse_profile(answer[2:])
+        elif body[0] == stk.CMD_READ_FLASH_HVSP:
+            readback += answer[2:2 + READ_CHUNK]
+
+    def phase_us(phase):
+        return {name: round(c[4] * 1e6 / hclk, 1) for name, c in profiles[phase].items() if c[0]}
+
+    flash = re.search(r"flash programmed in ([\d.]+) us", report)
+    program_us = float(flash.group(1)) if flash else 0.0
+    verify_us = round(sum(phase_us("verify").get(n, 0.0) for n in ("cmd_exec", "pipe_wait")), 1)
+    util = re.search(r"wire utilisation ([\d.]+) % \(([\d.]+) %", report)
+    violations = re.search(r"(\d+) timing violations", report)
+    injected = re.search(r"injected (\d+) SDO bit flips, (\d+) busy extensions, (\d+) dropped", report)
+    programmed = len(image.rstrip(b"\xff"))
+    retry = {}
+    for phase in ("program", "verify"):
+        c = profiles[phase].get("retry")
+        if c and c[0]:
+            retry[phase] = {"count": c[0], "total_us": round(c[4] * 1e6 / hclk, 1),
+                            "max_us": round(c[2] * 1e6 / hclk, 1)}
+
+    return {
+        "key": "/".join([device, "%.2f" % fill, transport, phy, compression]),
+        "device": device, "fill": fill, "transport": transport, "phy": phy,
+        "compression": compression,
+        "bytes_programmed": programmed,
+        "verified": readback == image,
+        "program_us": program_us,
+        "verify_us": verify_us,
+        "program_Bps": round(programmed / (program_us / 1e6), 1) if program_us else 0.0,
+        "verify_Bps": round(size / (verify_us / 1e6), 1) if verify_us else 0.0,
+        "phases_us": {"program": phase_us("program"), "verify": phase_us("verify")},
+        "wire_utilisation_pct": float(util.group(1)) if util else None,
+        "wire_utilisation_active_pct": float(util.group(2)) if util else None,
+        "link_bytes": {"to_programmer": sent, "to_host": received},
+        "timing_violations": int(violations.group(1)) if violations else None,
+        "injected": [int(n) for n in injected.groups()] if injected else [0, 0, 0],
+        "retries": retry,
+        "failed_commands": errors,
+        "wall_s": round(wall, 3),
+        "exit": rc,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--programmer", default="build/host/programmer")
+    parser.add_argument("--out", default="build/bench.json")
+    parser.add_argument("--baseline", help="stored result to compare against")
+    parser.add_argument("--update-baseline", action="store_true")
+    parser.add_argument("--tolerance", type=float, default=5.0, help="allowed slowdown in percent")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--quick", action="store_true", help="one device, pipe transport only")
+    parser.add_argument("--no-faults", action="store_true", help="skip the fault-injection runs")
+    args = parser.parse_args()
+
+    matrix = dict(MATRIX)
+    if args.quick:
+        matrix["device"] = matrix["device"][:1]
+        matrix["transport"] = ["pipe"]
+
+    results = []
+    failed = False
+    for combo in itertools.product(*matrix.values()):
+        r = run_one(args, combo)
+        results.append(r)
+        ok = r["verified"] and r["exit"] == 0
+        failed |= not ok
+        print("%-36s program %9.1f us (%8.0f B/s)  verify %9.1f us  wire %5.1f %%  %s"
+              % (r["key"], r["program_us"], r["program_Bps"], r["verify_us"],
+                 r["wire_utilisation_active_pct"] or 0.0, "ok" if ok else "FAILED"))
+
+    faults = []
+    if not args.no_faults:
+        clean = None
+        for name, spec in FAULTS.items():
+            r = run_one(args, FAULT_COMBO, spec, FAULT_RETRIES)
+            r["key"] = "faults/" + name
+            clean = clean or r
+            r["program_slowdown_pct"] = round((r["program_us"] / clean["program_us"] - 1) * 100, 1)
+            r["verify_slowdown_pct"] = round((r["verify_us"] / clean["verify_us"] - 1) * 100, 1)
+            faults.append(r)
+            if spec is None:
+                failed |= not r["verified"]
+            retries = sum(p["count"] for p in r["retries"].values())
+            worst = max([p["max_us"] for p in r["retries"].values()] or [0.0])
+            print("%-36s program %+6.1f %%  verify %+6.1f %%  injected %s  retries %4d  "
+                  "worst recovery %8.1f us  %s"
+                  % (r["key"], r["program_slowdown_pct"], r["verify_slowdown_pct"],
+                     "/".join(map(str, r["injected"])), retries, worst,
+                     "ok" if r["verified"] else "UNRECOVERABLE" if spec else "FAILED"))
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.out)), exist_ok=True)
+    with open(args.out, "w") as f:
+        json.dump({"matrix": matrix, "results": results, "faults": faults}, f, indent=2)
+
+    if args.baseline and args.update_baseline:
+        base = {r["key"]: {"program_us": r["program_us"], "verify_us": r["verify_us"]}
+                for r in results}
+        with open(args.baseline, "w") as f:
+            json.dump(base, f, indent=2, sort_keys=True)
+            f.write("\n")
+    elif args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            base = json.load(f)
+        limit = 1 + args.tolerance / 100
+        for r in results:
+            b = base.get(r["key"])
+            if b is None:
+                print("STALE BASELINE %s: not in %s" % (r["key"], args.baseline))
+                failed = True
+                continue
+            for metric in ("program_us", "verify_us"):
+                if r[metric] > b[metric] * limit:
+                    print("REGRESSION %s %s: %.1f -> %.1f us" % (r["key"], metric, b[metric], r[metric]))
+                    failed = True
+                elif r[metric] * limit < b[metric]:
+                    print("STALE BASELINE %s %s: %.1f -> %.1f us, rerun with --update-baseline"
+                          % (r["key"], metric, b[metric], r[metric]))
+                    failed = True
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Host link throughput and latency, without the programming logic.
+
+Uses the firmware's link self-test (CMD_LINK_TEST / CMD_LINK_STATS):
+
+  sink    the host streams --bytes, the programmer discards them,
+  source  the programmer streams --bytes of a generated pattern,
+  echo    --packets packets of each --sizes are looped back one at a time.
+
+Reports MB/s for each mode, per-packet round-trip percentiles for echo,
+and the programmer's own byte and chunk counters, so buffer sizes can be
+tuned on the transport alone. Runs against a serial port (--port) or
+starts the host build on a pseudo-terminal.
+
+    make linkbench
+    tools/linkbench.py --port /dev/ttyUSB0 --baud 115200 --bytes 65536
+    tools/linkbench.py --port /dev/ttyUSB0 --switch-baud 3000000 [--autobaud]
+"""
+
+import argparse
+import json
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import stk500v2 as stk  # noqa: E402
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def pattern(n):
+    """The source mode stream: byte i is i & 0xFF."""
+    return bytes(i & 0xFF for i in range(256)) * (n // 256) + bytes(range(n % 256))
+
+
+def start(link, mode, count):
+    link.check([stk.CMD_LINK_TEST, mode] + list(struct.pack("<I", count)))
+
+
+def stats(link):
+    data = link.check([stk.CMD_LINK_STATS])
+    mode, rx, tx, rx_chunks, tx_chunks, ticks, tick_hz, rx_laps = struct.unpack_from("<B7I", data)
+    result = {"rx_bytes": rx, "tx_bytes": tx, "rx_chunks": rx_chunks, "tx_chunks": tx_chunks,
+              "rx_laps": rx_laps}
+    if ticks and tick_hz:
+        result["device_s"] = ticks / tick_hz
+    return result
+
+
+def run_sink(link, args):
+    payload = os.urandom(args.bytes)
+    start(link, stk.LINKTEST_SINK, args.bytes)
+    t = time.perf_counter()
+    for off in range(0, args.bytes, args.chunk):
+        link.send(payload[off:off + args.chunk])
+    counters = stats(link)
+    wall = time.perf_counter() - t
+    return {"bytes": args.bytes, "wall_s": wall, "MBps": args.bytes / wall / 1e6,
+            "ok": counters["rx_bytes"] == args.bytes and counters["rx_laps"] == 0,
+            "counters": counters}
+
+
+def run_source(link, args):
+    start(link, stk.LINKTEST_SOURCE, args.bytes)
+    t = time.perf_counter()
+    data = link.receive(args.bytes)
+    wall = time.perf_counter() - t
+    counters = stats(link)
+    return {"bytes": args.bytes, "wall_s": wall, "MBps": args.bytes / wall / 1e6,
+            "ok": data == pattern(args.bytes) and counters["tx_bytes"] == args.bytes,
+            "counters": counters}
+
+
+def run_echo(link, args, size):
+    start(link, stk.LINKTEST_ECHO, size * args.packets)
+    rtt = []
+    ok = True
+    t = time.perf_counter()
+    for _ in range(args.packets):
+        packet = os.urandom(size)
+        sent = time.perf_counter()
+        link.send(packet)
+        ok &= link.receive(size) == packet
+        rtt.append(time.perf_counter() - sent)
+    wall = time.perf_counter() - t
+    counters = stats(link)
+    return {"size": size, "packets": args.packets, "wall_s": wall,
+            "MBps": size * args.packets / wall / 1e6,
+            "rtt_us": {p: percentile(rtt, int(p[1:])) * 1e6 for p in ("p50", "p90", "p99")}
+            | {"max": max(rtt) * 1e6},
+            "ok": ok and counters["tx_bytes"] == size * args.packets, "counters": counters}
+
+
+def run(args, link):
+    link.check([stk.CMD_SIGN_ON])
+    if args.switch_baud:
+        link.set_baudrate(args.switch_baud, args.autobaud)
+        link.check([stk.CMD_SIGN_ON])
+    result = {"sink": run_sink(link, args), "source": run_source(link, args), "echo": []}
+    for size in args.sizes:
+        result["echo"].append(run_echo(link, args, size))
+    return result
+
+
+def with_programmer(args):
+    link_path = os.path.join(tempfile.mkdtemp(), "ttyHVSP")
+    proc = subprocess.Popen([args.programmer, "-n", "-l", link_path], stderr=subprocess.PIPE)
+    try:
+        deadline = time.time() + 5
+        while not os.path.exists(link_path):
+            if time.time() > deadline or proc.poll() is not None:
+                raise RuntimeError("programmer did not open the link")
+            time.sleep(0.01)
+        with stk.Link(link_path, timeout=args.timeout) as link:
+            return run(args, link)
+    finally:
+        proc.terminate()
+        proc.communicate()
+        if os.path.lexists(link_path):
+            os.unlink(link_path)
+        os.rmdir(os.path.dirname(link_path))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", help="serial device; default: start the host build")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--switch-baud", type=int, help="move the link to this rate first")
+    parser.add_argument("--autobaud", action="store_true", help="let the programmer measure it")
+    parser.add_argument("--programmer", default="build/host/programmer")
+    parser.add_argument("--bytes", type=int, default=1 << 20, help="sink and source length")
+    parser.add_argument("--chunk", type=int, default=256, help="host write size in sink mode")
+    parser.add_argument("--packets", type=int, default=1000, help="echo packets per size")
+    parser.add_argument("--sizes", type=lambda s: [int(x) for x in s.split(",")],
+                        default=[1, 16, 64, 256], help="echo packet sizes")
+    parser.add_argument("--timeout", type=float, default=5.0)
+    parser.add_argument("--json", help="write the result to this file")
+    args = parser.parse_args()
+
+    if args.port:
+        with stk.Link(args.port, args.baud, timeout=args.timeout) as link:
+            result = run(args, link)
+    else:
+        result = with_programmer(args)
+
+    ok = True
+    for mode in ("sink", "source"):
+        r = result[mode]
+        ok &= r["ok"]
+        print("%-6s %9d B  %8.3f MB/s  rx %d B in %d chunks, tx %d B in %d chunks  %s"
+              % (mode, r["bytes"], r["MBps"], r["counters"]["rx_bytes"], r["counters"]["rx_chunks"],
+                 r["counters"]["tx_bytes"], r["counters"]["tx_chunks"], "ok" if r["ok"] else "FAILED"))
+    for r in result["echo"]:
+        ok &= r["ok"]
+        print("echo   %4d B x %5d  %8.3f MB/s  rtt p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f us  %s"
+              % (r["size"], r["packets"], r["MBps"], r["rtt_us"]["p50"], r["rtt_us"]["p90"],
+                 r["rtt_us"]["p99"], r["rtt_us"]["max"], "ok" if r["ok"] else "FAILED"))
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
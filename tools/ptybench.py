@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Full-stack benchmark against the host build of the programmer.
+
+Starts build/host/programmer on a pseudo-terminal, then programs and
+verifies a random flash image through the STK500v2 link exactly as a host
+tool would, and reports wall-clock throughput and per-command latency.
+
+    make host
+    tools/ptybench.py --device attiny85 [--json result.json]
+"""
+
+import argparse
+import json
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import stk500v2 as stk  # noqa: E402
+
+# flash bytes, page bytes
+DEVICES = {
+    "attiny13": (1024, 32),
+    "attiny24": (2048, 32),
+    "attiny44": (4096, 64),
+    "attiny84": (8192, 64),
+    "attiny25": (2048, 32),
+    "attiny45": (4096, 64),
+    "attiny85": (8192, 64),
+}
+
+MODE_PAGE_WRITE = 0xC1
+READ_CHUNK = 256
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+class Timed:
+    """Link wrapper that keeps the round-trip time of every command."""
+
+    def __init__(self, link):
+        self.link = link
+        self.latency = {}
+
+    def check(self, body):
+        t = time.perf_counter()
+        data = self.link.check(body)
+        self.latency.setdefault(body[0], []).append(time.perf_counter() - t)
+        return data
+
+
+def run(args):
+    flash_size, page = DEVICES[args.device]
+    image = bytes(random.Random(args.seed).randrange(256) for _ in range(flash_size))
+    link_path = os.path.join(tempfile.mkdtemp(), "ttyHVSP")
+
+    proc = subprocess.Popen([args.programmer, "-d", args.device, "-l", link_path],
+                            stderr=subprocess.PIPE)
+    try:
+        deadline = time.time() + 5
+        while not os.path.exists(link_path):
+            if time.time() > deadline or proc.poll() is not None:
+                raise RuntimeError("programmer did not open the link")
+            time.sleep(0.01)
+
+        with stk.Link(link_path, timeout=5.0) as link:
+            t = Timed(link)
+            phases = {}
+
+            start = time.perf_counter()
+            t.check([stk.CMD_SIGN_ON])
+            t.check([stk.CMD_ENTER_PROGMODE_HVSP, 100, 0, 0, 0, 0, 0, 0, 0])
+            t.check([stk.CMD_CHIP_ERASE_HVSP, 0, 10])
+            phases["setup"] = time.perf_counter() - start
+
+            start = time.perf_counter()
+            t.check([stk.CMD_LOAD_ADDRESS, 0, 0, 0, 0])
+            for off in range(0, flash_size, page):
+                chunk = list(image[off:off + page])
+                t.check([stk.CMD_PROGRAM_FLASH_HVSP, 0, page, MODE_PAGE_WRITE, 10] + chunk)
+            phases["write"] = time.perf_counter() - start
+
+            start = time.perf_counter()
+            readback = b""
+            t.check([stk.CMD_LOAD_ADDRESS, 0, 0, 0, 0])
+            for off in range(0, flash_size, READ_CHUNK):
+                data = t.check([stk.CMD_READ_FLASH_HVSP, READ_CHUNK >> 8, READ_CHUNK & 0xFF])
+                readback += bytes(data[:READ_CHUNK])
+            phases["read"] = time.perf_counter() - start
+
+            t.check([stk.CMD_LEAVE_PROGMODE_HVSP, 1, 1])
+    finally:
+        proc.terminate()
+        _, err = proc.communicate()
+        if os.path.lexists(link_path):
+            os.unlink(link_path)
+        os.rmdir(os.path.dirname(link_path))
+
+    result = {
+        "device": args.device,
+        "bytes": flash_size,
+        "verified": readback == image,
+        "phases_s": phases,
+        "write_Bps": flash_size / phases["write"],
+        "read_Bps": flash_size / phases["read"],
+        "latency_us": {
+            "0x%02x" % cmd: {
+                "count": len(v),
+                "p50": percentile(v, 50) * 1e6,
+                "p99": percentile(v, 99) * 1e6,
+            }
+            for cmd, v in sorted(t.latency.items())
+        },
+        "target": err.decode().strip().splitlines(),
+        "exit": proc.returncode,
+    }
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--device", default="attiny85", choices=sorted(DEVICES))
+    parser.add_argument("--programmer", default="build/host/programmer")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--json", help="write the result to this file")
+    args = parser.parse_args()
+
+    result = run(args)
+    print("%s: %d bytes, write %.0f B/s, read %.0f B/s, verify %s"
+          % (result["device"], result["bytes"], result["write_Bps"], result["read_Bps"],
+             "ok" if result["verified"] else "FAILED"))
+    for cmd, lat in result["latency_us"].items():
+        print("  cmd %s: %4d x, p50 %7.1f us, p99 %7.1f us" % (cmd, lat["count"], lat["p50"], lat["p99"]))
+    for line in result["target"]:
+        print("  " + line)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+    return 0 if result["verified"] else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
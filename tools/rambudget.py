@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""RAM budget of the firmware image, optionally with measured peaks.
+
+From the ELF (no binutils needed): the size of every RAM section, the
+largest static objects in them (frame pool, page and link buffers, ring),
+the session arena (_sarena.._earena) and the stack reservation
+(_earena.._estack). With --su, the deepest frames from the -fstack-usage
+files. With --port, the programmer's own measurements: the stack
+high-water mark from the painted reservation (CMD_STACK_STATS) and the
+arena high-water mark (CMD_ARENA_STATS), so the stack and arena sizes in
+STM32F103X6_FLASH.ld can be set from numbers instead of guesses.
+
+    make ram
+    tools/rambudget.py build/firmware.elf --su 'build/firmware-*.su' --port /dev/ttyUSB0
+"""
+
+import argparse
+import glob
+import json
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import stk500v2 as stk  # noqa: E402
+
+RAM_BASE = 0x20000000
+RAM_SIZE = 10 * 1024
+
+SHF_ALLOC = 0x2
+SHT_SYMTAB = 2
+STT_OBJECT = 1
+
+
+class Elf:
+    """The parts of a 32-bit little-endian ELF this report needs."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1 or self.data[5] != 1:
+            raise ValueError("%s: not a 32-bit little-endian ELF" % path)
+        shoff, = struct.unpack_from("<I", self.data, 32)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", self.data, 46)
+        headers = [struct.unpack_from("<10I", self.data, shoff + i * shentsize)
+                   for i in range(shnum)]
+        names = headers[shstrndx]
+        self.sections = []
+        for h in headers:
+            self.sections.append({
+                "name": self._str(names[4], h[0]), "type": h[1], "flags": h[2],
+                "addr": h[3], "offset": h[4], "size": h[5], "link": h[6],
+                "entsize": h[9],
+            })
+        self.symbols = {}
+        self.objects = []
+        for s in self.sections:
+            if s["type"] != SHT_SYMTAB:
+                continue
+            strtab = self.sections[s["link"]]["offset"]
+            for off in range(s["offset"], s["offset"] + s["size"], s["entsize"]):
+                name, value, size, info, _, _ = struct.unpack_from("<IIIBBH", self.data, off)
+                name = self._str(strtab, name)
+                if not name:
+                    continue
+                self.symbols[name] = value
+                if info & 0xF == STT_OBJECT and size:
+                    self.objects.append((name, value, size))
+
+    def _str(self, table, off):
+        end = self.data.index(b"\0", table + off)
+        return self.data[table + off:end].decode()
+
+    def ram_sections(self):
+        return [s for s in self.sections if s["flags"] & SHF_ALLOC and s["size"]
+                and RAM_BASE <= s["addr"] < RAM_BASE + RAM_SIZE]
+
+
+def stack_usage(pattern):
+    """-fstack-usage files -> [(bytes, function, qualifier)], deepest first."""
+    frames = []
+    for path in glob.glob(pattern):
+        with open(path) as f:
+            for line in f:
+                where, size, qualifier = line.rstrip("\n").split("\t")
+                frames.append((int(size), where.rsplit(":", 1)[-1], qualifier))
+    return sorted(frames, reverse=True)
+
+
+def measure(port, baud):
+    with stk.Link(port, baud) as link:
+        stack = struct.unpack("<III", link.check([stk.CMD_STACK_STATS]))
+        arena = struct.unpack("<III", link.check([stk.CMD_ARENA_STATS]))
+    return {
+        "stack_size": stack[0], "stack_high_water": stack[1], "stack_depth": stack[2],
+        "arena_size": arena[0], "arena_used": arena[1], "arena_high_water": arena[2],
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", nargs="?", default="build/firmware.elf")
+    parser.add_argument("--su", help="glob of -fstack-usage files, e.g. 'build/firmware-*.su'")
+    parser.add_argument("--port", help="serial device of a running programmer")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--top", type=int, default=10, help="objects and frames to list")
+    parser.add_argument("--json", help="write the result to this file")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    sym = elf.symbols
+    result = {"sections": {}, "objects": [], "frames": []}
+
+    print("%-20s %10s %6s" % ("section", "address", "bytes"))
+    for s in elf.ram_sections():
+        if s["name"] == "._user_arena_stack":
+            continue
+        print("%-20s 0x%08x %6d" % (s["name"], s["addr"], s["size"]))
+        result["sections"][s["name"]] = s["size"]
+    arena = sym["_earena"] - sym["_sarena"]
+    stack = sym["_estack"] - sym["_earena"]
+    print("%-20s 0x%08x %6d  (min %d)" % ("arena", sym["_sarena"], arena,
+                                           sym.get("_Min_Arena_Size", 0)))
+    print("%-20s 0x%08x %6d" % ("stack", sym["_earena"], stack))
+    result["sections"]["arena"] = arena
+    result["sections"]["stack"] = stack
+    static = sym["_sarena"] - RAM_BASE
+    print("static %d + arena %d + stack %d = %d of %d bytes"
+          % (static, arena, stack, static + arena + stack, RAM_SIZE))
+
+    ram = [o for o in elf.objects if RAM_BASE <= o[1] < RAM_BASE + RAM_SIZE]
+    ram.sort(key=lambda o: o[2], reverse=True)
+    print("\nlargest RAM objects")
+    for name, addr, size in ram[:args.top]:
+        print("  %-28s 0x%08x %6d" % (name, addr, size))
+        result["objects"].append({"name": name, "addr": addr, "size": size})
+
+    if args.su:
+        frames = stack_usage(args.su)
+        print("\ndeepest frames (-fstack-usage)")
+        for size, name, qualifier in frames[:args.top]:
+            print("  %-28s %6d  %s" % (name, size, qualifier))
+            result["frames"].append({"name": name, "size": size, "qualifier": qualifier})
+
+    if args.port:
+        m = measure(args.port, args.baud)
+        result["measured"] = m
+        print("\nmeasured since reset")
+        print("  stack  high-water %5d of %5d bytes, %d at the handler%s"
+              % (m["stack_high_water"], m["stack_size"], m["stack_depth"],
+                 "  REACHED THE ARENA" if m["stack_high_water"] >= m["stack_size"] else ""))
+        print("  arena  high-water %5d of %5d bytes, %d in use"
+              % (m["arena_high_water"], m["arena_size"], m["arena_used"]))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
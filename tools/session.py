@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""Record STK500v2 programming sessions and replay them on the host build.
+
+record: sits between a host tool and a programmer on a pseudo-terminal and
+logs every message body in both directions with its timing. The programmer
+is either real hardware (--port) or the host build (--programmer):
+
+    tools/session.py record --port /dev/ttyUSB0 --link /tmp/ttyREC -o s.log &
+    avrdude -c stk500hvsp -P /tmp/ttyREC -p t85 -U flash:w:fw.hex
+
+replay: feeds the recorded host commands into the host build, either with
+the recorded gaps (--speed recorded) or back to back (--speed max), checks
+the answers against the recording and reports timing. Simulated times use
+the definitions of tools/bench.py: program time from the target model,
+first Write Flash command to the end of the last page write, and command
+time as the firmware's PROF_CMD_EXEC plus PROF_PIPE_WAIT totals:
+
+    tools/session.py replay s.log --device attiny85 [--json out.json]
+
+Log format, little-endian: the 8-byte header "STKSESS1", then records of
+direction (1 byte, 'H' host to programmer, 'P' programmer to host), time
+since the previous record in us (u32), body length (u16) and the body.
+"""
+
+import argparse
+import json
+import os
+import re
+import select
+import signal
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+import tty
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import stk500v2 as stk  # noqa: E402
+
+MAGIC = b"STKSESS1"
+RECORD = struct.Struct("<cIH")
+
+# Answers that depend on timing or history rather than on the command
+UNCHECKED = {stk.CMD_GET_BOOT_TIMES, stk.CMD_GET_PROFILE, stk.CMD_TRACE_DUMP,
+             stk.CMD_LINK_STATS, stk.CMD_ARENA_STATS, stk.CMD_STACK_STATS}
+
+
+def write_log(path, records):
+    with open(path, "wb") as f:
+        f.write(MAGIC)
+        for direction, delta_us, body in records:
+            f.write(RECORD.pack(direction, delta_us, len(body)))
+            f.write(body)
+
+
+def read_log(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:len(MAGIC)] != MAGIC:
+        raise ValueError("%s: not a session log" % path)
+    records = []
+    off = len(MAGIC)
+    while off < len(data):
+        direction, delta_us, size = RECORD.unpack_from(data, off)
+        off += RECORD.size
+        records.append((direction, delta_us, data[off:off + size]))
+        off += size
+    return records
+
+
+def start_programmer(programmer, device):
+    """Starts the host build on a pty and returns (process, link path)."""
+    link = os.path.join(tempfile.mkdtemp(), "ttyHVSP")
+    proc = subprocess.Popen([programmer, "-d", device, "-s", "-l", link], stderr=subprocess.PIPE)
+    deadline = time.time() + 5
+    while not os.path.exists(link):
+        if time.time() > deadline or proc.poll() is not None:
+            raise RuntimeError("programmer did not open the link")
+        time.sleep(0.01)
+    return proc, link
+
+
+def stop_programmer(proc, link):
+    proc.terminate()
+    _, err = proc.communicate()
+    if os.path.lexists(link):
+        os.unlink(link)
+    os.rmdir(os.path.dirname(link))
+    return err.decode()
+
+
+def record(args):
+    proc = None
+    if args.programmer:
+        proc, port = start_programmer(args.programmer, args.device)
+    else:
+        port = args.port
+    dev = os.open(port, os.O_RDWR | os.O_NOCTTY)
+    if os.isatty(dev):
+        tty.setraw(dev)
+
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    name = os.ttyname(slave)
+    if os.path.lexists(args.link):
+        os.unlink(args.link)
+    os.symlink(name, args.link)
+    print("recording on %s" % args.link, file=sys.stderr)
+
+    # Stop cleanly on SIGTERM as well, background jobs often ignore SIGINT
+    signal.signal(signal.SIGTERM, signal.default_int_handler)
+    readers = {master: (b"H", stk.FrameReader()), dev: (b"P", stk.FrameReader())}
+    peer = {master: dev, dev: master}
+    records = []
+    last = time.perf_counter()
+    try:
+        while True:
+            ready, _, _ = select.select(list(readers), [], [])
+            for fd in ready:
+                data = os.read(fd, 4096)
+                os.write(peer[fd], data)
+                direction, reader = readers[fd]
+                for body in reader.feed(data):
+                    now = time.perf_counter()
+                    records.append((direction, int((now - last) * 1e6), body))
+                    last = now
+    except KeyboardInterrupt:
+        pass
+    finally:
+        write_log(args.output, records)
+        os.unlink(args.link)
+        os.close(dev)
+        if proc:
+            print(stop_programmer(proc, port), file=sys.stderr, end="")
+    print("%d records written to %s" % (len(records), args.output), file=sys.stderr)
+    return 0
+
+
+def replay(args):
+    records = read_log(args.log)
+    proc, link_path = start_programmer(args.programmer, args.device)
+    latencies = []
+    mismatches = []
+    try:
+        with stk.Link(link_path, timeout=10.0) as link:
+            start = time.perf_counter()
+            pending = None
+            for direction, delta_us, body in records:
+                if direction == b"H":
+                    if args.speed == "recorded":
+                        time.sleep(delta_us / 1e6)
+                    t = time.perf_counter()
+                    status, data = link.command(body)
+                    latencies.append(time.perf_counter() - t)
+                    pending = (body[0], bytes([body[0], status]) + bytes(data))
+                elif pending is not None:
+                    cmd, answer = pending
+                    if cmd not in UNCHECKED and answer != body:
+                        mismatches.append({"command": "0x%02x" % cmd, "index": len(latencies) - 1})
+                    pending = None
+            wall = time.perf_counter() - start
+
+            # Simulated command time of the whole replay, as bench.py's
+            # verify time: the deterministic figure to track, wall time
+            # depends on the machine
+            hclk = int.from_bytes(link.check([stk.CMD_GET_BOOT_TIMES])[4:8], "little")
+            status, data = link.command([stk.CMD_GET_PROFILE])
+            profile = stk.parse_profile(data) if status == stk.STATUS_CMD_OK else {}
+            exec_us = (sum(profile[n][4] for n in ("cmd_exec", "pipe_wait") if n in profile) * 1e6
+                       / hclk if "cmd_exec" in profile else None)
+    finally:
+        report = stop_programmer(proc, link_path)
+
+    # Simulated program time, as bench.py's: only when the session wrote flash
+    flash = re.search(r"flash programmed in ([\d.]+) us, (\d+) pages", report)
+    program_us = float(flash.group(1)) if flash and int(flash.group(2)) else None
+
+    latencies.sort()
+    result = {
+        "log": args.log,
+        "speed": args.speed,
+        "commands": len(latencies),
+        "wall_s": round(wall, 3),
+        "sim_program_us": program_us,
+        "sim_exec_us": round(exec_us, 1) if exec_us is not None else None,
+        "latency_us": {
+            "p50": round(latencies[len(latencies) // 2] * 1e6, 1) if latencies else 0,
+            "p99": round(latencies[min(len(latencies) - 1, len(latencies) * 99 // 100)] * 1e6, 1)
+            if latencies else 0,
+        },
+        "answer_mismatches": mismatches,
+        "target": report.strip().splitlines(),
+    }
+    print("%d commands in %.3f s (%s speed), p50 %.1f us, p99 %.1f us, %d answer mismatches"
+          % (result["commands"], wall, args.speed, result["latency_us"]["p50"],
+             result["latency_us"]["p99"], len(mismatches)))
+    if program_us is not None:
+        print("  simulated program time %.1f us" % program_us)
+    if exec_us is not None:
+        print("  simulated command time %.1f us" % exec_us)
+    for line in result["target"]:
+        print("  " + line)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2)
+    return 1 if mismatches and args.strict else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    rec = sub.add_parser("record", help="log a session between a host tool and a programmer")
+    where = rec.add_mutually_exclusive_group(required=True)
+    where.add_argument("--port", help="programmer serial device")
+    where.add_argument("--programmer", help="host build to start instead of hardware")
+    rec.add_argument("--device", default="attiny85", help="target model for --programmer")
+    rec.add_argument("--link", required=True, help="pty symlink for the host tool")
+    rec.add_argument("-o", "--output", required=True)
+    rec.set_defaults(func=record)
+
+    rep = sub.add_parser("replay", help="feed a recorded session into the host build")
+    rep.add_argument("log")
+    rep.add_argument("--programmer", default="build/host/programmer")
+    rep.add_argument("--device", default="attiny85")
+    rep.add_argument("--speed", choices=["recorded", "max"], default="max")
+    rep.add_argument("--strict", action="store_true", help="fail on answer mismatches")
+    rep.add_argument("--json", help="write the result to this file")
+    rep.set_defaults(func=replay)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Turns the SIM_BENCH firmware's semihosting output into instruction counts.
+
+Reads "bench <name> <iterations> <ticks>" lines on stdin (make sim pipes
+QEMU into this script). Under QEMU with -icount shift=N every instruction
+takes 2**N ns of virtual time and SysTick runs at the machine's core clock,
+so instructions = ticks * 1e9 / (systick_hz * 2**N). With --hardware the
+ticks are taken as core cycles instead.
+
+--baseline compares against a stored result and fails when a benchmark
+grew by more than --tolerance percent; --save writes the current result.
+"""
+
+import argparse
+import json
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--systick-hz", type=float, default=120e6,
+                        help="SysTick clock of the emulated machine (netduino2: 120 MHz)")
+    parser.add_argument("--icount-shift", type=int, default=0)
+    parser.add_argument("--hardware", action="store_true", help="ticks are core cycles")
+    parser.add_argument("--baseline", help="JSON result to compare against")
+    parser.add_argument("--tolerance", type=float, default=2.0, help="allowed growth in percent")
+    parser.add_argument("--save", help="write the result as JSON")
+    args = parser.parse_args()
+
+    unit = "cycles" if args.hardware else "insns"
+    result = {}
+    for line in sys.stdin:
+        fields = line.split()
+        if len(fields) != 4 or fields[0] != "bench":
+            sys.stdout.write(line)
+            continue
+        name, iterations, ticks = fields[1], int(fields[2]), int(fields[3])
+        per_iter = ticks / iterations
+        if not args.hardware:
+            per_iter *= 1e9 / (args.systick_hz * (1 << args.icount_shift))
+        result[name] = round(per_iter, 1)
+        print("%-16s %10.1f %s/iteration" % (name, per_iter, unit))
+
+    if not result:
+        print("no benchmark output", file=sys.stderr)
+        return 1
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"unit": unit, "results": result}, f, indent=2, sort_keys=True)
+
+    failed = False
+    if args.baseline:
+        with open(args.baseline) as f:
+            base = json.load(f)["results"]
+        for name, value in sorted(result.items()):
+            if name in base and value > base[name] * (1 + args.tolerance / 100):
+                print("REGRESSION %s: %.1f -> %.1f %s" % (name, base[name], value, unit))
+                failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,253 @@
+"""Minimal STK500v2 client for the programmer's host link.
+
+Used by the diagnostics tools in this directory. Talks to a serial device
+(or a pseudo-terminal) with termios only, so no third-party packages are
+needed.
+"""
+
+import os
+import select
+import struct
+import termios
+import time
+import tty
+
+MESSAGE_START = 0x1B
+TOKEN = 0x0E
+
+CMD_SIGN_ON = 0x01
+CMD_SET_PARAMETER = 0x02
+CMD_GET_PARAMETER = 0x03
+CMD_LOAD_ADDRESS = 0x06
+CMD_ENTER_PROGMODE_HVSP = 0x30
+CMD_LEAVE_PROGMODE_HVSP = 0x31
+CMD_CHIP_ERASE_HVSP = 0x32
+CMD_PROGRAM_FLASH_HVSP = 0x33
+CMD_READ_FLASH_HVSP = 0x34
+CMD_PROGRAM_EEPROM_HVSP = 0x35
+CMD_READ_EEPROM_HVSP = 0x36
+CMD_PROGRAM_FUSE_HVSP = 0x37
+CMD_READ_FUSE_HVSP = 0x38
+CMD_PROGRAM_LOCK_HVSP = 0x39
+CMD_READ_LOCK_HVSP = 0x3A
+CMD_READ_SIGNATURE_HVSP = 0x3B
+CMD_READ_OSCCAL_HVSP = 0x3C
+CMD_GET_BOOT_TIMES = 0x80
+CMD_GET_PROFILE = 0x81
+CMD_RESET_PROFILE = 0x82
+CMD_TRACE_DUMP = 0x83
+CMD_TRACE_CLEAR = 0x84
+CMD_LINK_TEST = 0x85
+CMD_LINK_STATS = 0x86
+CMD_SET_BAUD = 0x87
+CMD_ARENA_STATS = 0x88
+CMD_STACK_STATS = 0x89
+
+LINKTEST_SINK = 1
+LINKTEST_SOURCE = 2
+LINKTEST_ECHO = 3
+
+PARAM_HVSP_RETRIES = 0xA0
+PARAM_HVSP_KEEPALIVE = 0xA1
+
+STATUS_CMD_OK = 0x00
+
+BAUDRATES = {
+    9600: termios.B9600,
+    19200: termios.B19200,
+    38400: termios.B38400,
+    57600: termios.B57600,
+    115200: termios.B115200,
+    230400: termios.B230400,
+    460800: termios.B460800,
+    921600: termios.B921600,
+    1000000: termios.B1000000,
+    1500000: termios.B1500000,
+    2000000: termios.B2000000,
+    3000000: termios.B3000000,
+    4000000: termios.B4000000,
+}
+
+
+PROFILE_NAMES = [
+    "frame_shift", "page_load", "page_write_wait", "host_rx_parse",
+    "decompress", "crc", "link_tx", "cmd_exec", "retry",
+    "pipe_wait", "idle",
+]
+
+
+class ProtocolError(Exception):
+    pass
+
+
+def encode(seq, body):
+    """Wraps a message body into a frame."""
+    body = bytes(body)
+    frame = bytes([MESSAGE_START, seq & 0xFF, len(body) >> 8, len(body) & 0xFF, TOKEN]) + body
+    csum = 0
+    for b in frame:
+        csum ^= b
+    return frame + bytes([csum])
+
+
+def decode_stream(stream):
+    """Splits a byte stream of answer frames into their bodies."""
+    bodies = []
+    i = 0
+    while i + 5 <= len(stream):
+        if stream[i] != MESSAGE_START:
+            i += 1
+            continue
+        size = (stream[i + 2] << 8) | stream[i + 3]
+        bodies.append(bytes(stream[i + 5:i + 5 + size]))
+        i += 6 + size
+    return bodies
+
+
+class FrameReader:
+    """Incremental frame parser for one direction of a byte stream."""
+
+    def __init__(self):
+        self.buf = b""
+
+    def feed(self, data):
+        """Adds received bytes and returns the bodies of completed frames."""
+        self.buf += data
+        bodies = []
+        while True:
+            start = self.buf.find(bytes([MESSAGE_START]))
+            if start < 0:
+                self.buf = b""
+                return bodies
+            self.buf = self.buf[start:]
+            if len(self.buf) < 5:
+                return bodies
+            size = (self.buf[2] << 8) | self.buf[3]
+            if self.buf[4] != TOKEN:
+                self.buf = self.buf[1:]
+                continue
+            if len(self.buf) < size + 6:
+                return bodies
+            bodies.append(self.buf[5:5 + size])
+            self.buf = self.buf[size + 6:]
+
+
+def parse_profile(data):
+    """CMD_GET_PROFILE answer data -> {name: (count, min, max, avg, total)}."""
+    result = {}
+    for i, name in enumerate(PROFILE_NAMES):
+        if len(data) < 24 * (i + 1):
+            break
+        count, lo, hi, avg, tot_l, tot_h = struct.unpack_from("<6I", data, 24 * i)
+        result[name] = (count, lo, hi, avg, tot_l | (tot_h << 32))
+    return result
+
+
+class Link:
+    """One STK500v2 session over a tty."""
+
+    def __init__(self, path, baudrate=115200, timeout=1.0):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        self.timeout = timeout
+        self.seq = 0
+        if os.isatty(self.fd):
+            tty.setraw(self.fd)
+            self._set_speed(baudrate)
+
+    def _set_speed(self, baudrate):
+        if os.isatty(self.fd):
+            attrs = termios.tcgetattr(self.fd)
+            speed = BAUDRATES.get(baudrate, termios.B115200)
+            attrs[4] = attrs[5] = speed
+            termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+
+    def set_baudrate(self, baudrate, autobaud=False):
+        """Moves both ends of the link to a new rate with CMD_SET_BAUD.
+
+        With autobaud the programmer measures the rate from a 0x55 sync
+        byte instead of being told, which also corrects for a bridge whose
+        real rate differs from the nominal one.
+        """
+        self.check([CMD_SET_BAUD] + list(struct.pack("<I", 0 if autobaud else baudrate)))
+        if os.isatty(self.fd):
+            termios.tcdrain(self.fd)
+        self._set_speed(baudrate)
+        if autobaud:
+            time.sleep(0.01)
+            os.write(self.fd, b"\x55")
+            if os.isatty(self.fd):
+                termios.tcdrain(self.fd)
+            time.sleep(0.01)
+
+    def close(self):
+        os.close(self.fd)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _read(self, n):
+        buf = b""
+        while len(buf) < n:
+            ready, _, _ = select.select([self.fd], [], [], self.timeout)
+            if not ready:
+                raise ProtocolError("timeout")
+            buf += os.read(self.fd, n - len(buf))
+        return buf
+
+    def send(self, data):
+        """Writes raw bytes, e.g. the payload of a link test."""
+        data = memoryview(bytes(data))
+        while data:
+            n = os.write(self.fd, data)
+            data = data[n:]
+
+    def receive(self, n):
+        """Reads exactly n raw bytes."""
+        return self._read(n)
+
+    def command(self, body):
+        """Sends one message body and returns (status, data) of the answer."""
+        body = bytes(body)
+        os.write(self.fd, encode(self.seq, body))
+
+        while self._read(1)[0] != MESSAGE_START:
+            pass
+        seq, size_h, size_l, token = self._read(4)
+        size = (size_h << 8) | size_l
+        answer = self._read(size)
+        csum = MESSAGE_START ^ seq ^ size_h ^ size_l ^ token
+        for b in answer:
+            csum ^= b
+        if self._read(1)[0] != csum or token != TOKEN:
+            raise ProtocolError("bad answer frame")
+        if seq != self.seq:
+            raise ProtocolError("sequence mismatch")
+        self.seq = (self.seq + 1) & 0xFF
+        if answer[0] != body[0]:
+            raise ProtocolError("answer to 0x%02x for command 0x%02x" % (answer[0], body[0]))
+        return answer[1], answer[2:]
+
+    def check(self, body):
+        """Like command() but raises unless the status is STATUS_CMD_OK."""
+        status, data = self.command(body)
+        if status != STATUS_CMD_OK:
+            raise ProtocolError("command 0x%02x failed with status 0x%02x" % (body[0], status))
+        return data
+
+    def trace_dump(self):
+        """Returns (hclk, [(cycles, event, arg, data), ...]) for the whole ring."""
+        records = []
+        first = 0
+        hclk = 0
+        while True:
+            data = self.check([CMD_TRACE_DUMP] + list(struct.pack("<I", first)))
+            head, first, hclk = struct.unpack_from("<III", data)
+            recs = data[12:]
+            for off in range(0, len(recs), 8):
+                records.append(struct.unpack_from("<IBBH", recs, off))
+            first += len(recs) // 8
+            if first == head or not recs:
+                return hclk, records
@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Converts the firmware event trace into Chrome/Perfetto trace JSON.
+
+Fetch straight from the programmer:
+
+    tools/trace2chrome.py --port /dev/ttyUSB0 -o trace.json
+
+or convert a raw dump saved earlier with --save (8-byte records, preceded
+by a 4-byte little-endian HCLK in Hz):
+
+    tools/trace2chrome.py --input trace.bin -o trace.json
+
+Open the result in chrome://tracing or https://ui.perfetto.dev.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+from stk500v2 import Link
+
+TRACE_ISR_ENTER = 1
+TRACE_ISR_EXIT = 2
+TRACE_CMD_START = 3
+TRACE_CMD_END = 4
+TRACE_PAGE_STATE = 5
+TRACE_RETRY = 6
+TRACE_MARK = 7
+TRACE_BAUD = 8
+TRACE_TARGET = 9
+TRACE_BOOT = 10
+
+# prog_page_state_t in include/prog.h
+PAGE_STATES = {0: "idle", 1: "loading", 2: "writing"}
+# prog_target_t in include/prog.h
+TARGET_STATES = {0: "target off", 1: "target on", 2: "target parked"}
+
+
+def unwrap(records):
+    """Turns 32-bit CYCCNT stamps into a monotonic 64-bit cycle count.
+
+    Every boot restarts CYCCNT at zero (boot_start()), so each TRACE_BOOT
+    opens a new epoch that begins right after the last record of the
+    previous one; the time the core spent in reset is unknown.
+    """
+    base = 0
+    last = None
+    for cycles, event, arg, data in records:
+        if event == TRACE_BOOT:
+            if last is not None:
+                base += last + 1 - cycles
+            last = None
+        if last is not None and cycles < last:
+            base += 1 << 32
+        last = cycles
+        yield base + cycles, event, arg, data
+
+
+def convert(hclk, records):
+    events = []
+    mhz = hclk / 1e6
+    t0 = None
+    for cycles, event, arg, data in unwrap(records):
+        if t0 is None:
+            t0 = cycles
+        ts = (cycles - t0) / mhz
+        common = {"pid": 1, "ts": ts}
+        if event in (TRACE_ISR_ENTER, TRACE_ISR_EXIT):
+            events.append(dict(common, tid="irq", name="exc %d" % arg,
+                               ph="B" if event == TRACE_ISR_ENTER else "E"))
+        elif event == TRACE_CMD_START:
+            events.append(dict(common, tid="host", name="cmd 0x%02x" % arg, ph="B",
+                               args={"length": data}))
+        elif event == TRACE_CMD_END:
+            events.append(dict(common, tid="host", name="cmd 0x%02x" % arg, ph="E",
+                               args={"status": data}))
+        elif event == TRACE_PAGE_STATE:
+            events.append(dict(common, tid="page", name=PAGE_STATES.get(arg, "page state %d" % arg),
+                               ph="i", s="t", args={"page": data}))
+            events.append(dict(common, name="page state", ph="C", args={"state": arg}))
+        elif event == TRACE_RETRY:
+            events.append(dict(common, tid="retry", name="retry op %d" % arg, ph="i", s="p",
+                               args={"attempt": data}))
+        elif event == TRACE_BAUD:
+            events.append(dict(common, tid="host", name="autobaud" if arg else "baud", ph="i", s="p",
+                               args={"brr": data}))
+        elif event == TRACE_BOOT:
+            events.append(dict(common, name="warm reset" if arg else "power-up", ph="i", s="g"))
+        elif event == TRACE_TARGET:
+            name = "target resumed" if data else TARGET_STATES.get(arg, "target state %d" % arg)
+            events.append(dict(common, tid="target", name=name, ph="i", s="t"))
+        else:
+            events.append(dict(common, tid="mark", name="mark %d" % arg, ph="i", s="t",
+                               args={"data": data}))
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument("--port", help="programmer serial port")
+    src.add_argument("--input", help="raw dump written by --save")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--save", help="also write the raw dump here")
+    ap.add_argument("-o", "--output", default="-")
+    args = ap.parse_args()
+
+    if args.port:
+        with Link(args.port, args.baud) as link:
+            hclk, records = link.trace_dump()
+    else:
+        with open(args.input, "rb") as f:
+            raw = f.read()
+        hclk = struct.unpack_from("<I", raw)[0]
+        records = [struct.unpack_from("<IBBH", raw, off) for off in range(4, len(raw) - 7, 8)]
+
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(struct.pack("<I", hclk))
+            for rec in records:
+                f.write(struct.pack("<IBBH", *rec))
+
+    out = sys.stdout if args.output == "-" else open(args.output, "w")
+    json.dump(convert(hclk, records), out)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()